@@ -0,0 +1,100 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+/**
+ * Replacements for the global allocation functions that keep a running count
+ * of heap allocations. Used by the debug overlay to show how many allocations
+ * are made each frame so that regressions in the render path are easy to spot.
+ *
+ * Allocations are counted per thread so that background saves, dumps and
+ * thread pool tasks don't show up in the main thread's numbers.
+ */
+
+static thread_local size_t HEAP_ALLOCATIONS = 0;
+
+
+static void* counted_alloc(size_t size)
+{
+	HEAP_ALLOCATIONS++;
+	return std::malloc(size ? size : 1);
+}
+
+
+/**
+ * Gets the number of heap allocations the calling thread has made since it
+ * started.
+ */
+size_t heapAllocationCount()
+{
+	return HEAP_ALLOCATIONS;
+}
+
+
+void* operator new(size_t size)
+{
+	void* p = counted_alloc(size);
+	if (!p)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+
+void* operator new[](size_t size)
+{
+	void* p = counted_alloc(size);
+	if (!p)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_alloc(size);
+}
+
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_alloc(size);
+}
+
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+
+void operator delete[](void* p, size_t) noexcept
+{
+	std::free(p);
+}
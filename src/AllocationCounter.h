@@ -0,0 +1,5 @@
+#pragma once
+
+#include <cstddef>
+
+size_t heapAllocationCount();
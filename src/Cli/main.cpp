@@ -0,0 +1,483 @@
+/**
+ * landlord-cli
+ * 
+ * Headless front end to the map code for batch jobs on machines without a
+ * display or a GPU. Nothing here creates a window, a Renderer or an OpenGL
+ * context. Maps are loaded with the same code the editor uses and work is
+ * spread across a ThreadPool, one map per task.
+ * 
+ * Usage: landlord-cli [options] <command> [map ...]
+ * 
+ * With no maps given every map in the maps directory is processed.
+ */
+#include "NAS2D/NAS2D.h"
+
+#include "../Defaults.h"
+#include "../ThreadPool.h"
+
+#include "../Map/Map.h"
+#include "../Map/MapIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace NAS2D;
+
+
+const std::string	MAP_XML_EXTENSION		= ".xml";
+const std::string	MAP_RENDER_EXTENSION	= ".png";
+
+const int			MAX_REPORTED_ERRORS		= 10;	/**< Number of bad tiles listed per layer before the rest are only counted. */
+
+
+/**
+ * Options given on the command line.
+ */
+struct Options
+{
+	Options(): threads(0), encoding(ENCODING_UNKNOWN), binary(false) {}
+
+	std::string					command;	/**< Command to run on each map. */
+	std::string					directory;	/**< Directory the maps are read from. */
+	std::string					output;		/**< Directory converted maps and renders are written to. */
+
+	unsigned int				threads;	/**< Number of worker threads. 0 uses one per hardware thread. */
+
+	LevelEncoding				encoding;	/**< Level encoding converted XML maps are saved with. ENCODING_UNKNOWN keeps the map's own. */
+	bool						binary;		/**< Flag indicating that maps are converted to the binary format. */
+
+	std::vector<std::string>	files;		/**< Maps to process, relative to the maps directory. */
+};
+
+
+/**
+ * Outcome of running a command on a single map.
+ */
+struct Result
+{
+	Result(): ok(false) {}
+
+	std::string		log;		/**< Everything the command had to say about the map. */
+	bool			ok;			/**< Flag indicating that the command succeeded. */
+};
+
+
+static void usage()
+{
+	cout << "Usage: landlord-cli [options] <command> [map ...]" << endl << endl;
+	cout << "Commands:" << endl;
+	cout << "  stats                Print the size, memory use and links of each map." << endl;
+	cout << "  validate             Check tilesets, tile indices, links and edge exits." << endl;
+	cout << "  render               Render each map to a PNG." << endl;
+	cout << "  convert <format>     Save each map as 'binary', 'xml' or as XML with the" << endl;
+	cout << "                       level encoding 'text', 'csv', 'rle' or 'base64_zlib'." << endl << endl;
+	cout << "Options:" << endl;
+	cout << "  -d <dir>             Maps directory within the data path. Default '" << EDITOR_MAPS_PATH << "'." << endl;
+	cout << "  -o <dir>             Output directory for 'convert' and 'render'. Default is the maps directory." << endl;
+	cout << "  -j <threads>         Number of worker threads. Default is one per hardware thread." << endl << endl;
+	cout << "With no maps given every map in the maps directory is processed." << endl;
+}
+
+
+/**
+ * Makes sure a directory path ends with a separator.
+ */
+static std::string directoryPath(const std::string& path)
+{
+	if (path.empty() || path[path.size() - 1] == '/')
+		return path;
+
+	return path + "/";
+}
+
+
+/**
+ * Replaces the extension of a file name, or adds one if it has none.
+ */
+static std::string replaceExtension(const std::string& file, const std::string& extension)
+{
+	size_t dot = file.find_last_of('.');
+	if (dot == std::string::npos || file.find_first_of('/', dot) != std::string::npos)
+		return file + extension;
+
+	return file.substr(0, dot) + extension;
+}
+
+
+/**
+ * Parses the command line.
+ * 
+ * \return	False if the command line doesn't make sense.
+ */
+static bool parseOptions(int argc, char *argv[], Options& options)
+{
+	options.directory = EDITOR_MAPS_PATH;
+
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; i++)
+	{
+		if (i + 1 >= argc)
+			return false;
+
+		if (strcmp(argv[i], "-d") == 0)
+			options.directory = directoryPath(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0)
+			options.output = directoryPath(argv[++i]);
+		else if (strcmp(argv[i], "-j") == 0)
+			options.threads = static_cast<unsigned int>(atoi(argv[++i]));
+		else
+			return false;
+	}
+
+	if (i >= argc)
+		return false;
+
+	options.command = argv[i++];
+
+	if (options.command == "convert")
+	{
+		if (i >= argc)
+			return false;
+
+		std::string format = argv[i++];
+		if (format == "binary")
+			options.binary = true;
+		else if (format != "xml")
+		{
+			// Encoding names are upper case in the map files.
+			std::transform(format.begin(), format.end(), format.begin(), ::toupper);
+			options.encoding = levelEncoding(format.c_str(), format.size());
+			if (options.encoding == ENCODING_UNKNOWN)
+				return false;
+		}
+	}
+	else if (options.command != "stats" && options.command != "validate" && options.command != "render")
+	{
+		return false;
+	}
+
+	if (options.output.empty())
+		options.output = options.directory;
+
+	for (; i < argc; i++)
+		options.files.push_back(argv[i]);
+
+	return true;
+}
+
+
+/**
+ * Gets the files in a directory, ignoring subdirectories.
+ */
+static StringList fileList(const std::string& directory)
+{
+	Filesystem& f = Utility<Filesystem>::get();
+
+	StringList fileList = f.directoryList(directory);
+	StringList returnList;
+
+	for (size_t i = 0; i < fileList.size(); i++)
+		if (!f.isDirectory(directory + fileList[i]))
+			returnList.push_back(fileList[i]);
+
+	return returnList;
+}
+
+
+/**
+ * Prints the size, memory use and links of a map.
+ */
+static bool stats(Map& map, std::ostream& log)
+{
+	MapSnapshot snapshot = map.snapshot();
+	const GameField& field = snapshot.field;
+
+	log << "  name:       " << snapshot.name << endl;
+	log << "  size:       " << field.width() << " x " << field.height() << " cells" << endl;
+	log << "  chunks:     " << field.chunksWide() << " x " << field.chunksHigh() << " (" << field.allocatedBytes() / 1024 << " KiB allocated)" << endl;
+	log << "  tileset:    " << snapshot.tilesetPath << " (" << map.tileset().numTiles() << " tiles)" << endl;
+	log << "  encoding:   " << levelEncodingName(snapshot.levelEncoding) << endl;
+	log << "  links:      " << field.links().size() << endl;
+
+	if (snapshot.edgeExit)
+		log << "  edge exit:  " << snapshot.edgeExitDestination << " (" << snapshot.edgeExitPosition.x() << ", " << snapshot.edgeExitPosition.y() << ")" << endl;
+
+	return true;
+}
+
+
+/**
+ * Checks that a link destination names an existing map and that the
+ * position is within that map.
+ */
+static bool validateDestination(const MapIndex& index, const std::string& what, const std::string& destination, const Point_2d& position, std::ostream& log)
+{
+	const MapIndex::Entry* entry = index.find(destination);
+	if (!entry || !entry->valid)
+	{
+		log << "  " << what << " leads to missing map '" << destination << "'." << endl;
+		return false;
+	}
+
+	if (position.x() < 0 || position.y() < 0 || position.x() >= entry->width || position.y() >= entry->height)
+	{
+		log << "  " << what << " leads to (" << position.x() << ", " << position.y() << ") outside of '" << destination << "' (" << entry->width << " x " << entry->height << ")." << endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Checks a map for tile indices outside of its tileset and for links and
+ * edge exits that lead nowhere.
+ * 
+ * A missing or unreadable tileset, or anything else the loader couldn't
+ * read, already fails the map before it gets here.
+ */
+static bool validate(Map& map, const MapIndex& index, std::ostream& log)
+{
+	MapSnapshot snapshot = map.snapshot();
+	const GameField& field = snapshot.field;
+
+	const int tileCount = map.tileset().numTiles();
+	bool ok = true;
+
+	for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+	{
+		int badTiles = 0;
+
+		for (int y = 0; y < field.height(); y++)
+		{
+			for (int x = 0; x < field.width(); )
+			{
+				const GameField::TileIndex* span = field.span(static_cast<Cell::TileLayer>(layer), x, y);
+
+				int count = std::min(GameField::spanLength(x), field.width() - x);
+				for (int i = 0; i < count; i++, x++)
+				{
+					if (span[i] == Cell::EMPTY_INDEX || (span[i] >= 0 && span[i] < tileCount))
+						continue;
+
+					if (badTiles++ < MAX_REPORTED_ERRORS)
+						log << "  Layer " << layer << " cell (" << x << ", " << y << ") uses tile " << span[i] << " of " << tileCount << "." << endl;
+				}
+			}
+		}
+
+		if (badTiles > MAX_REPORTED_ERRORS)
+			log << "  Layer " << layer << " has " << badTiles - MAX_REPORTED_ERRORS << " more bad tiles." << endl;
+
+		if (badTiles > 0)
+			ok = false;
+	}
+
+	std::vector<const LinkTable::Link*> linkList = field.links().sorted();
+	for (size_t i = 0; i < linkList.size(); i++)
+	{
+		const LinkTable::Link* link = linkList[i];
+
+		std::stringstream what;
+		what << "Link at (" << link->x << ", " << link->y << ")";
+
+		if (!validateDestination(index, what.str(), field.links().name(link->destination), link->position, log))
+			ok = false;
+	}
+
+	if (snapshot.edgeExit && !validateDestination(index, "Edge exit", snapshot.edgeExitDestination, snapshot.edgeExitPosition, log))
+		ok = false;
+
+	return ok;
+}
+
+
+/**
+ * Saves a map in another format or level encoding.
+ * 
+ * Maps changing between the XML and binary formats get the matching
+ * extension. Converting in place replaces the original.
+ */
+static bool convert(Map& map, const Options& options, const std::string& file, std::ostream& log)
+{
+	std::string path = file;
+	if (options.binary && !isBinaryMapPath(path))
+		path = replaceExtension(path, MAP_BINARY_EXTENSION);
+	else if (!options.binary && isBinaryMapPath(path))
+		path = replaceExtension(path, MAP_XML_EXTENSION);
+
+	if (options.encoding != ENCODING_UNKNOWN)
+		map.levelEncoding(options.encoding);
+
+	if (!Map::save(map.snapshot(), options.output + path))
+	{
+		log << "  Unable to save '" << options.output + path << "'." << endl;
+		return false;
+	}
+
+	log << "  Saved '" << options.output + path << "'." << endl;
+	return true;
+}
+
+
+/**
+ * Renders a map to a PNG.
+ */
+static bool render(Map& map, const Options& options, const std::string& file, std::ostream& log)
+{
+	std::string path = options.output + replaceExtension(file, MAP_RENDER_EXTENSION);
+
+	if (!Map::dump(map.snapshot(), map.tileset(), path))
+	{
+		log << "  Unable to render '" << path << "'." << endl;
+		return false;
+	}
+
+	log << "  Rendered '" << path << "'." << endl;
+	return true;
+}
+
+
+/**
+ * Loads a map and runs the command on it.
+ * 
+ * \note	Runs on a worker thread. Must not throw.
+ */
+static void process(const Options& options, const MapIndex& index, const std::string& file, Result& result)
+{
+	std::stringstream log;
+
+	try
+	{
+		Map map(options.directory + file);
+
+		// A map that didn't load cleanly is missing whatever the loader
+		// had to skip. Only stats is still worth running on it.
+		const StringList& loadErrors = map.loadErrors();
+		for (size_t i = 0; i < loadErrors.size(); i++)
+			log << "  " << loadErrors[i] << endl;
+
+		if (!loadErrors.empty() && options.command != "stats")
+		{
+			log << "  Map didn't load cleanly." << endl;
+			result.ok = false;
+		}
+		else if (options.command == "stats")
+			result.ok = stats(map, log);
+		else if (options.command == "validate")
+			result.ok = validate(map, index, log);
+		else if (options.command == "convert")
+			result.ok = convert(map, options, file, log);
+		else if (options.command == "render")
+			result.ok = render(map, options, file, log);
+	}
+	catch (Exception e)
+	{
+		log << "  " << e.getBriefDescription() << ": " << e.getDescription() << endl;
+		result.ok = false;
+	}
+	catch (std::exception& e)
+	{
+		log << "  " << e.what() << endl;
+		result.ok = false;
+	}
+
+	result.log = log.str();
+}
+
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		usage();
+		return 2;
+	}
+
+	try
+	{
+		Utility<Filesystem>::get().init(argv[0], "data");
+	}
+	catch (Exception e)
+	{
+		cout << "Error (" << e.getCode() << "): " << e.getDescription() << endl;
+		return 1;
+	}
+
+	Filesystem& f = Utility<Filesystem>::get();
+	if (!f.isDirectory(options.directory))
+	{
+		cout << "Maps directory '" << options.directory << "' doesn't exist." << endl;
+		return 1;
+	}
+
+	if (!f.isDirectory(options.output) && !f.makeDirectory(options.output))
+	{
+		cout << "Unable to create output directory '" << options.output << "'." << endl;
+		return 1;
+	}
+
+	ThreadPool pool(options.threads);
+
+	// Headers of every map in the directory, not just the ones being
+	// processed, so that links can be checked without loading their
+	// destinations.
+	StringList lst = fileList(options.directory);
+
+	MapIndex index;
+	index.refresh(options.directory, lst, pool);
+
+	if (options.files.empty())
+	{
+		for (size_t i = 0; i < lst.size(); i++)
+		{
+			const MapIndex::Entry* entry = index.find(lst[i]);
+			if (entry && entry->valid && entry->compatible())
+				options.files.push_back(lst[i]);
+		}
+	}
+
+	std::vector<Result> results(options.files.size());
+
+	if (options.command == "render")
+	{
+		// Map::dump() already spreads a single map across every hardware
+		// thread so maps are rendered one after another.
+		for (size_t i = 0; i < options.files.size(); i++)
+			process(options, index, options.files[i], results[i]);
+	}
+	else
+	{
+		for (size_t i = 0; i < options.files.size(); i++)
+		{
+			const std::string* file = &options.files[i];
+			Result* result = &results[i];
+
+			pool.enqueue([&options, &index, file, result] { process(options, index, *file, *result); });
+		}
+
+		pool.wait();
+	}
+
+	size_t failed = 0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		cout << options.directory << options.files[i] << (results[i].ok ? "" : " FAILED") << endl;
+		cout << results[i].log;
+
+		if (!results[i].ok)
+			++failed;
+	}
+
+	cout << endl << options.command << ": " << results.size() - failed << " of " << results.size() << " maps succeeded." << endl;
+
+	return failed > 0 ? 1 : 0;
+}
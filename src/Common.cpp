@@ -2,8 +2,23 @@
 
 #include "NAS2D/NAS2D.h"
 
+#include "physfs.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<unsigned int> TEMP_FILE_COUNTER(0);		// Keeps the temporary files of concurrent writeFileAtomic() calls apart.
+
 void flipBool(bool& b)
 {
 	b = !b;
@@ -194,3 +209,107 @@ void BlendPixel(SDL_Surface *srf, int x, int y, Uint8 R, Uint8 G, Uint8 B, Uint8
 	if(SDL_MUSTLOCK(srf))
 		SDL_UnlockSurface(srf);
 }
+
+
+/**
+ * Writes a file in the NAS2D Filesystem's write directory without ever
+ * leaving it half written.
+ * 
+ * The data goes to a temporary file next to the destination which is
+ * flushed to disk and then renamed over the destination. If anything fails
+ * along the way the destination is left as it was. Every call gets a temporary
+ * file of its own so concurrent writers of the same file can't clobber each
+ * other's, the last one to finish wins.
+ * 
+ * \param	path	Path of the file within the write directory.
+ * \param	write	Writes the contents of the file to the stream it's given.
+ *					Returns false if it couldn't.
+ * 
+ * \note	Goes straight to the native filesystem instead of through NAS2D
+ *			so it's safe to call from a worker thread.
+ */
+bool writeFileAtomic(const std::string& path, const std::function<bool(std::ostream&)>& write)
+{
+	const char* writeDir = PHYSFS_getWriteDir();
+	if (!writeDir)
+		return false;
+
+	std::string nativePath = std::string(writeDir) + PHYSFS_getDirSeparator() + path;
+	for (size_t i = 0; i < nativePath.size(); i++)
+	{
+		if (nativePath[i] == '/')
+			nativePath[i] = PHYSFS_getDirSeparator()[0];
+	}
+
+#if defined(_WIN32)
+	const unsigned long processId = GetCurrentProcessId();
+#else
+	const unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+
+	std::stringstream tempName;
+	tempName << nativePath << "." << processId << "." << TEMP_FILE_COUNTER.fetch_add(1) << ".tmp";
+	const std::string tempPath = tempName.str();
+
+	{
+		std::ofstream file(tempPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		if (!write(file) || !file.flush())
+		{
+			file.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	// Make sure the data is on disk before the rename can be, otherwise a
+	// crash could leave an empty file in place of the destination.
+#if defined(_WIN32)
+	HANDLE handle = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE || !FlushFileBuffers(handle))
+	{
+		if (handle != INVALID_HANDLE_VALUE)
+			CloseHandle(handle);
+
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	CloseHandle(handle);
+#else
+	int fd = open(tempPath.c_str(), O_RDONLY);
+	if (fd < 0 || fsync(fd) != 0)
+	{
+		if (fd >= 0)
+			close(fd);
+
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	close(fd);
+#endif
+
+#if defined(_WIN32)
+	if (!MoveFileExA(tempPath.c_str(), nativePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#else
+	if (std::rename(tempPath.c_str(), nativePath.c_str()) != 0)
+#endif
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Writes a block of data to a file without ever leaving it half written.
+ */
+bool writeFileAtomic(const std::string& path, const std::string& data)
+{
+	return writeFileAtomic(path, [&data](std::ostream& stream) { return !stream.write(data.data(), data.size()).fail(); });
+}
@@ -4,6 +4,8 @@
 
 using namespace NAS2D;
 
+#include <functional>
+#include <ostream>
 #include <string>
 #include <memory>
 
@@ -15,6 +17,9 @@ int stringToInt(const std::string& s);
 
 std::string TrimString(const std::string& src, const std::string& c = " \r\n");
 
+bool writeFileAtomic(const std::string& path, const std::function<bool(std::ostream&)>& write);
+bool writeFileAtomic(const std::string& path, const std::string& data);
+
 void DrawPixel(SDL_Surface *srf, int x, int y, Uint8 R, Uint8 G, Uint8 B, Uint8 A);
 void BlendPixel(SDL_Surface *srf, int x, int y, Uint8 R, Uint8 G, Uint8 B, Uint8 A);
 
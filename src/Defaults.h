@@ -6,5 +6,10 @@ const std::string	UI_TEXTFIELD_DEFAULT_WIDTH			= "50";
 const std::string	UI_TEXTFIELD_DEFAULT_HEIGHT			= "50";
 
 const std::string	EDITOR_MAPS_PATH					= "maps/";
+const std::string	EDITOR_MAP_INDEX_PATH				= "maps.idx";
 const std::string	EDITOR_TSET_PATH					= "tsets/";
 const std::string	EDITOR_NEW_MAP_NAME					= "New Map";
+const std::string	EDITOR_PROFILE_PATH					= "profile.csv";
+const std::string	EDITOR_TRACE_PATH					= "trace.json";
+
+const std::string	EDITOR_UNDO_BUDGET_OPTION			= "undo_budget_mb";
@@ -1,9 +1,15 @@
 #include "EditorState.h"
 #include "StartState.h"
 
+#include "AllocationCounter.h"
 #include "Common.h"
+#include "Defaults.h"
+#include "FrameProfiler.h"
+#include "TraceRecorder.h"
 
-#include <stack>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
 
 
 const bool			SHOW_DEBUG_DEFAULT	= false;
@@ -11,11 +17,10 @@ const bool			HIDE_UI_DEFAULT		= false;
 
 const float			SCROLL_SPEED		= 250.0f;
 
-SDL_Surface*		MINI_MAP_SURFACE	= nullptr; // HACK!
+const unsigned int	AUTOSAVE_INTERVAL	= 120000;	/**< Milliseconds between autosaves. */
+const std::string	AUTOSAVE_SUFFIX		= ".autosave";
 
 
-std::stack<Point_2d> FLOOD_STACK;		// Stack used for contiguous flood fill.
-
 
 std::map<EditState, string>	StateStringMap;			/**< EditState string table. */
 std::map<int, EditState>	StateIntMap;			/**< EditState int table. */
@@ -41,18 +46,23 @@ bool layer_hidden(EditState _s, ToolBar& _t)
 }
 
 
-EditorState::EditorState(const string& mapPath):
+EditorState::EditorState(Map&& map, const string& mapPath):
 	mMousePointer(nullptr),
 	mPointer_Normal("sys/normal.png"),
 	mPointer_Fill("sys/fill.png"),
 	mPointer_Eraser("sys/eraser.png"),
 	mLayerHidden("sys/layer_hidden.png"),
 	mFont("fonts/ui-normal.png", 7, 9, 0),
-	mLinkCell(nullptr),
-	mMap(mapPath),
+	mMap(std::move(map)),
 	mMapSavePath(mapPath),
+	mAutosaveRevision(mMap.field().revision()),
+	mPendingSaves(0),
+	mSaveThread(1),
 	mEditState(STATE_BASE_TILE_INDEX),
 	mPreviousEditState(mEditState),
+	mAllocationCount(0),
+	mFrameAllocations(0),
+	mMapAllocations(0),
 	mDrawDebug(SHOW_DEBUG_DEFAULT),
 	mLeftButtonDown(false),
 	mRightButtonDown(false),
@@ -70,10 +80,15 @@ EditorState::EditorState(const string& name, const string& mapPath, const string
 	mPointer_Eraser("sys/eraser.png"),
 	mLayerHidden("sys/layer_hidden.png"),
 	mFont("fonts/ui-normal.png", 7, 9, 0),
-	mLinkCell(nullptr),
 	mMap(name, tsetPath, w, h),
 	mMapSavePath(mapPath),
+	mAutosaveRevision(mMap.field().revision()),
+	mPendingSaves(0),
+	mSaveThread(1),
 	mPreviousEditState(STATE_BASE_TILE_INDEX),
+	mAllocationCount(0),
+	mFrameAllocations(0),
+	mMapAllocations(0),
 	mDrawDebug(SHOW_DEBUG_DEFAULT),
 	mLeftButtonDown(false),
 	mRightButtonDown(false),
@@ -92,12 +107,6 @@ EditorState::~EditorState()
 	Utility<EventHandler>::get().mouseButtonUp().Disconnect(this, &EditorState::onMouseUp);
 	Utility<EventHandler>::get().mouseButtonDown().Disconnect(this, &EditorState::onMouseDown);
 	Utility<EventHandler>::get().quit().Disconnect(this, &EditorState::onQuit);
-
-	if (MINI_MAP_SURFACE)
-	{
-		SDL_FreeSurface(MINI_MAP_SURFACE);
-		MINI_MAP_SURFACE = nullptr;
-	}
 }
 
 /**
@@ -123,6 +132,36 @@ void EditorState::initialize()
 	Utility<EventHandler>::get().quit().Connect(this, &EditorState::onQuit);
 
 	mMap.viewport(Rectangle_2d(0, 32, Utility<Renderer>::get().width(), Utility<Renderer>::get().height() - 32));
+
+	mUndo.budget(undoBudget());
+	mUndo.field(&mMap.field());
+}
+
+
+/**
+ * Gets the memory budget for undo history from the 'undo_budget_mb' option
+ * in editor.xml, in megabytes. Falls back to the journal's default if the
+ * option isn't set or isn't a positive number.
+ */
+size_t EditorState::undoBudget() const
+{
+	const string option = Utility<Configuration>::get().option(EDITOR_UNDO_BUDGET_OPTION);
+	if (option.empty())
+		return mUndo.budget();
+
+	char* end = nullptr;
+	const long megabytes = strtol(option.c_str(), &end, 10);
+	if (*end != '\0' || megabytes <= 0)
+	{
+		cout << "Ignoring invalid " << EDITOR_UNDO_BUDGET_OPTION << " option '" << option << "'." << endl;
+		return mUndo.budget();
+	}
+
+	const size_t MEGABYTE = 1024 * 1024;
+	if (static_cast<unsigned long>(megabytes) > std::numeric_limits<size_t>::max() / MEGABYTE)
+		return std::numeric_limits<size_t>::max();
+
+	return static_cast<size_t>(megabytes) * MEGABYTE;
 }
 
 
@@ -218,10 +257,11 @@ void EditorState::fillStateToLayerTable()
  */
 void EditorState::button_MapLinkOkay_Click()
 {
-	if(mLinkCell)
+	if(mLinkCell.valid())
 	{
-		mLinkCell->link(mTxtLinkDestination.text());
-		mLinkCell->link_destination(Point_2d(stringToInt(mTxtLinkDestX.text()), stringToInt(mTxtLinkDestY.text())));
+		mUndo.beginStroke();
+		mUndo.link(mLinkCell.x(), mLinkCell.y(), mTxtLinkDestination.text(), Point_2d(stringToInt(mTxtLinkDestX.text()), stringToInt(mTxtLinkDestY.text())));
+		mUndo.endStroke();
 	}
 
 	mBtnLinkOkay.visible(false);
@@ -230,7 +270,7 @@ void EditorState::button_MapLinkOkay_Click()
 	mTxtLinkDestX.visible(false);
 	mTxtLinkDestY.visible(false);
 
-	mLinkCell = NULL;
+	mLinkCell = Cell();
 
 	restorePreviousState();
 }
@@ -256,28 +296,57 @@ void EditorState::button_MapLinkCancel_Click()
  */
 State* EditorState::update()
 {
+	Utility<FrameProfiler>::get().beginFrame();
+
+	TraceRecorder::instant("Frame", "frame");
+	TraceScope trace("EditorState::update", "frame");
+
+	size_t allocations = heapAllocationCount();
+	mFrameAllocations = allocations - mAllocationCount;
+	mAllocationCount = allocations;
+
 	Renderer& r = Utility<Renderer>::get();
 	r.clearScreen(COLOR_MAGENTA);
 
+	mOverlay.clear();
+
 	updateScroll();
 	updateSelector();
 
+	if(mAutosaveTimer.accumulator() > AUTOSAVE_INTERVAL)
+	{
+		mAutosaveTimer.reset();
+		autosave();
+	}
 
 	if(mHideUi)
 		return mReturnState;
 
 	if(mDrawDebug)
+	{
 		debug();
+		mMap.tileset().drawTileColorPalette(r.width() - 32, 50, 4, 6);
+	}
 
 	if(mEditState == STATE_MAP_LINK_EDIT)
 	{
-		r.drawBoxFilled(0, 0, r.width(), r.height(), 0, 0, 0, 65);
-		r.drawBox(mCellInspectRect, 255, 255, 0);
+		mOverlay.addBoxFilled(0.0f, 0.0f, r.width(), r.height(), Color_4ub(0, 0, 0, 65));
+		mOverlay.addBox(static_cast<float>(mCellInspectRect.x()), static_cast<float>(mCellInspectRect.y()), static_cast<float>(mCellInspectRect.w()), static_cast<float>(mCellInspectRect.h()), Color_4ub(255, 255, 0, 255));
+	}
+
+	{
+		ScopedTimer timer(STAGE_MAP_ABOVE);
+		mOverlay.drawOverlays(0.0f, 0.0f);
 	}
 
 	updateUI();
 
-	r.drawTextShadow(mFont, "Map File: " + mMapSavePath, r.screenCenterX() - (mFont.width("Map File: " + mMapSavePath) / 2), r.height() - (mFont.height() + 2), 1, 255, 255, 255, 0, 0, 0);
+	{
+		ScopedTimer timer(STAGE_TEXT);
+
+		std::string mapFile = "Map File: " + mMapSavePath + (mPendingSaves > 0 ? " (saving...)" : "");
+		r.drawTextShadow(mFont, mapFile, r.screenCenterX() - (mFont.width(mapFile) / 2), r.height() - (mFont.height() + 2), 1, 255, 255, 255, 0, 0, 0);
+	}
 
 	r.drawImage(*mMousePointer, mMouseCoords.x(), mMouseCoords.y());
 	if (layer_hidden(mEditState, mToolBar))
@@ -295,8 +364,12 @@ void EditorState::updateUI()
 	mToolBar.update();
 	mMiniMap.update();
 
-	r.drawTextShadow(mFont, string_format("World Tile: %i, %i", static_cast<int>((mMouseCoords.x() + mMap.cameraPosition().x()) / mMap.tileset().width()), static_cast<int>((mMouseCoords.y() + mMap.cameraPosition().y() - mMap.viewport().y()) / mMap.tileset().height())), 5, r.height() - 28, 1, 255, 255, 255, 0, 0, 0);
-	r.drawTextShadow(mFont, string_format("World Fine: %i, %i", static_cast<int>(mMouseCoords.x() + mMap.cameraPosition().x() - mMap.viewport().x()), static_cast<int>(mMouseCoords.y() + mMap.cameraPosition().y() - mMap.viewport().y())), 5, r.height() - 15, 1, 255, 255, 255, 0, 0, 0);
+	{
+		ScopedTimer timer(STAGE_TEXT);
+
+		r.drawTextShadow(mFont, string_format("World Tile: %i, %i", static_cast<int>((mMouseCoords.x() + mMap.cameraPosition().x()) / mMap.tileset().width()), static_cast<int>((mMouseCoords.y() + mMap.cameraPosition().y() - mMap.viewport().y()) / mMap.tileset().height())), 5, r.height() - 28, 1, 255, 255, 255, 0, 0, 0);
+		r.drawTextShadow(mFont, string_format("World Fine: %i, %i", static_cast<int>(mMouseCoords.x() + mMap.cameraPosition().x() - mMap.viewport().x()), static_cast<int>(mMouseCoords.y() + mMap.cameraPosition().y() - mMap.viewport().y())), 5, r.height() - 15, 1, 255, 255, 255, 0, 0, 0);
+	}
 
 	mTilePalette.update();
 
@@ -316,7 +389,10 @@ void EditorState::updateUI()
  */
 void EditorState::updateScroll()
 {
+	size_t allocations = heapAllocationCount();
 	mMap.update();
+	mMapAllocations = heapAllocationCount() - allocations;
+
 	if(!mHideUi)
 	{
 		mSelectorRect = mMap.injectMousePosition(mMouseCoords);
@@ -328,7 +404,13 @@ void EditorState::updateScroll()
 
 
 /**
- * Draws the tile selector based on the pattern selected in the TilePalette.
+ * Adds the tile selector to the overlays based on the pattern selected in
+ * the TilePalette.
+ * 
+ * The outline of every cell under the brush is added as one pixel wide
+ * filled strips, one per grid line instead of one box per cell, so that
+ * the selector goes out with the other filled overlays and stays beneath
+ * the link edit shade.
  */
 void EditorState::updateSelector()
 {
@@ -339,24 +421,25 @@ void EditorState::updateSelector()
 	if (mTilePalette.responding_to_events() || mMiniMap.responding_to_events())
 		return;
 
-	Renderer& r = Utility<Renderer>::get();
-
-	// Draw Tile Selector
-	int offsetX = 0, offsetY = 0;
-	
 	const Pattern* p = &mTilePalette.pattern();
 	if(mEditState == STATE_TILE_COLLISION || mToolBar.erase()) p = &mToolBar.brush();
 
-	for(int row = p->height(); row > 0; row--)
-	{
-		for(int col = p->width(); col > 0; col--)
-		{
-			r.drawBox(mSelectorRect.x() - offsetX + mMap.viewport().x(), mSelectorRect.y() - offsetY + mMap.viewport().y(), mSelectorRect.w(), mSelectorRect.h(), 255, 255, 255);
-			offsetX += 32;
-		}
-		offsetX = 0;
-		offsetY += 32;
-	}
+	const Color_4ub color(255, 255, 255, 255);
+
+	const float cellWidth = static_cast<float>(mSelectorRect.w());
+	const float cellHeight = static_cast<float>(mSelectorRect.h());
+
+	// The brush extends up and to the left of the cell under the mouse.
+	const float left = static_cast<float>(mSelectorRect.x() + mMap.viewport().x()) - (p->width() - 1) * cellWidth;
+	const float top = static_cast<float>(mSelectorRect.y() + mMap.viewport().y()) - (p->height() - 1) * cellHeight;
+	const float width = p->width() * cellWidth;
+	const float height = p->height() * cellHeight;
+
+	for(int col = 0; col <= p->width(); col++)
+		mOverlay.addBoxFilled(left + col * cellWidth, top, 1.0f, height + 1.0f, color);
+
+	for(int row = 0; row <= p->height(); row++)
+		mOverlay.addBoxFilled(left, top + row * cellHeight, width + 1.0f, 1.0f, color);
 }
 
 
@@ -365,6 +448,8 @@ void EditorState::updateSelector()
  */
 void EditorState::onKeyDown(KeyCode key, KeyModifier mod, bool repeat)
 {
+	TraceScope trace("EditorState::onKeyDown", "event");
+
 	if(repeat)
 		return;
 
@@ -400,9 +485,8 @@ void EditorState::onKeyDown(KeyCode key, KeyModifier mod, bool repeat)
 			mMap.showLinks(mDrawDebug);
 			break;
 
-		// Stealing this for dumping the minimap for now
 		case KEY_F2:
-			SDL_SaveBMP(MINI_MAP_SURFACE, "minimap.bmp");
+			dumpMap();
 			break;
 
 		case KEY_F3:
@@ -411,14 +495,25 @@ void EditorState::onKeyDown(KeyCode key, KeyModifier mod, bool repeat)
 			mTxtLinkDestination.visible(true);
 			mTxtLinkDestX.visible(true);
 			mTxtLinkDestY.visible(true);
-			mLinkCell = &mMap.getCell(mMouseCoords);
+			mLinkCell = mMap.getCell(mMouseCoords);
 			mCellInspectRect = mMap.injectMousePosition(mMouseCoords);
-			mTxtLinkDestination.text(mLinkCell->link());
-			mTxtLinkDestX.text(string_format("%i", mLinkCell->link_destination().x()));
-			mTxtLinkDestY.text(string_format("%i", mLinkCell->link_destination().y()));
+			mTxtLinkDestination.text(mLinkCell.link());
+			mTxtLinkDestX.text(string_format("%i", mLinkCell.link_destination().x()));
+			mTxtLinkDestY.text(string_format("%i", mLinkCell.link_destination().y()));
 			setState(STATE_MAP_LINK_EDIT);
 			break;
 
+		case KEY_F8:
+			TraceRecorder::toggle(EDITOR_TRACE_PATH);
+			break;
+
+		case KEY_F9:
+			if(Utility<FrameProfiler>::get().writeCsv(EDITOR_PROFILE_PATH))
+				cout << "Saved " << Utility<FrameProfiler>::get().frames() << " frames of stage timings to '" << EDITOR_PROFILE_PATH << "'." << endl;
+			else
+				cout << "Unable to save stage timings to '" << EDITOR_PROFILE_PATH << "'." << endl;
+			break;
+
 		case KEY_F10:
 			mHideUi = !mHideUi;
 			break;
@@ -426,11 +521,17 @@ void EditorState::onKeyDown(KeyCode key, KeyModifier mod, bool repeat)
 		case KEY_z:
 			if(KeyTranslator::control(mod))
 			{
-				if(!mFieldUndo.empty())
-				{
-					mMap.field(mFieldUndo);
-					mMiniMap.update_minimap();
-				}
+				if(mUndo.undo())
+					mMiniMap.update_minimap(mUndo.lastChangedArea());
+			}
+
+			break;
+
+		case KEY_y:
+			if(KeyTranslator::control(mod))
+			{
+				if(mUndo.redo())
+					mMiniMap.update_minimap(mUndo.lastChangedArea());
 			}
 
 			break;
@@ -446,6 +547,8 @@ void EditorState::onKeyDown(KeyCode key, KeyModifier mod, bool repeat)
  */
 void EditorState::onKeyUp(KeyCode key, KeyModifier mod)
 {
+	TraceScope trace("EditorState::onKeyUp", "event");
+
 	if(mEditState == STATE_MAP_LINK_EDIT)
 	{
 		return;
@@ -476,6 +579,8 @@ void EditorState::onQuit()
  */
 void EditorState::onMouseMove(int x, int y, int relX, int relY)
 {
+	TraceScope trace("EditorState::onMouseMove", "event");
+
 	if(mRightButtonDown && mEditState != STATE_MAP_LINK_EDIT)
 	{
 		mMap.moveCamera(relX, relY);
@@ -490,6 +595,10 @@ void EditorState::onMouseMove(int x, int y, int relX, int relY)
 		if (y < 32 || mToolBar.flood() || mTilePalette.responding_to_events() || mMiniMap.responding_to_events())
 			return;
 
+		// A drag that started over the UI starts its stroke once it reaches the map.
+		if(!mUndo.recording())
+			mUndo.beginStroke();
+
 		if(mEditState == STATE_TILE_COLLISION)
 			pattern_collision();
 		else
@@ -503,6 +612,8 @@ void EditorState::onMouseMove(int x, int y, int relX, int relY)
  */
 void EditorState::onMouseDown(MouseButton button, int x, int y)
 {
+	TraceScope trace("EditorState::onMouseDown", "event");
+
 	Utility<EventHandler>::get().grabMouse();
 
 	// Left Mouse Button
@@ -525,9 +636,13 @@ void EditorState::onMouseDown(MouseButton button, int x, int y)
  */
 void EditorState::onMouseUp(MouseButton button, int x, int y)
 {
+	TraceScope trace("EditorState::onMouseUp", "event");
+
 	if(button == BUTTON_LEFT)
 	{
 		mLeftButtonDown = false;
+		mUndo.endStroke();
+
 		if(mEditState == STATE_MAP_LINK_EDIT)
 		{
 		}
@@ -535,7 +650,11 @@ void EditorState::onMouseUp(MouseButton button, int x, int y)
 		{
 			if(mMapChanged)
 			{
-				mMiniMap.update_minimap();
+				// Erasing may leave whole layers of a chunk empty again.
+				if(mToolBar.erase())
+					mMap.field().compact();
+
+				mMiniMap.update_minimap(mUndo.lastChangedArea());
 				mMapChanged = false;
 			}
 		}
@@ -568,18 +687,18 @@ void EditorState::handleLeftButtonDown(int x, int y)
 		return;
 
 
-	Cell& cell = mMap.getCell(mMouseCoords);
+	Cell cell = mMap.getCell(mMouseCoords);
 
 	if(mEditState == STATE_TILE_COLLISION)
 	{
-		saveUndo();
-		cell.blocked(!cell.blocked());
+		mUndo.beginStroke();
+		mUndo.blocked(cell.x(), cell.y(), !cell.blocked());
 		mPlacingCollision = cell.blocked();
 		pattern_collision();
 	}
 	else
 	{
-		saveUndo();
+		mUndo.beginStroke();
 		changeTileTexture();
 	}
 }
@@ -601,7 +720,7 @@ void EditorState::changeTileTexture()
 	if (mToolBar.flood())
 	{
 		if (mToolBar.flood_contiguous())
-			patternFill_Contig(StateToLayer[mEditState], mMap.getGridCoords(mMouseCoords), mMap.getCell(mMouseCoords).index(StateToLayer[mEditState]));
+			patternFill_Contig(StateToLayer[mEditState], mMap.getGridCoords(mMouseCoords));
 		else
 			patternFill(StateToLayer[mEditState]);
 	}
@@ -619,50 +738,51 @@ void EditorState::changeTileTexture()
 
 /**
  * Fills a given cell layer with a pattern.
+ * 
+ * Spans are compared through the read-only span() first and only made
+ * writable if something in them changes, so filling a sparse layer with
+ * what's already there doesn't allocate chunks or unshare the ones held
+ * by a save snapshot.
  */
 void EditorState::patternFill(Cell::TileLayer layer)
 {
 	const Pattern& p = mTilePalette.pattern();
+	GameField& field = mMap.field();
+
+	for(int row = 0; row < field.height(); row++)
+	{
+		for(int col = 0; col < field.width(); )
+		{
+			const GameField::TileIndex* current = field.span(layer, col, row);
+			GameField::TileIndex* indices = nullptr;
+
+			int count = std::min(GameField::spanLength(col), field.width() - col);
+			for(int i = 0; i < count; i++, col++)
+			{
+				int index = p.value(col % p.width(), row % p.height());
+				if(current[i] == index)
+					continue;
+
+				if(!indices)
+				{
+					indices = field.writableSpan(layer, col - i, row);
+					current = indices;
+				}
 
-	for(int row = 0; row < mMap.height(); row++)
-		for(int col = 0; col < mMap.width(); col++)
-			mMap.getCellByGridCoords(col, row).index(layer, p.value(col % p.width(), row % p.height()));
+				mUndo.record(layer, col, row, indices[i], index);
+				indices[i] = static_cast<GameField::TileIndex>(index);
+			}
+		}
+	}
 }
 
 
 /**
  * Fills a contiguous area in a given layer with a pattern.
  */
-void EditorState::patternFill_Contig(Cell::TileLayer layer, const Point_2d& _pt, int seed_index)
+void EditorState::patternFill_Contig(Cell::TileLayer layer, const Point_2d& _pt)
 {
-	const Pattern& _pCheck = mTilePalette.pattern();
-	if (seed_index == _pCheck.value(_pt.x() % _pCheck.width(), _pt.y() % _pCheck.height()))
-		return;
-
-	while (!FLOOD_STACK.empty())
-		FLOOD_STACK.pop();
-
-	static const vector<int> dX = { 0, 1, 0, -1 }; // Neighbor Coords
-	static const vector<int> dY = { -1, 0, 1, 0 }; // Neighbor Coords
-
-	FLOOD_STACK.push(_pt);
-	
-	while(!FLOOD_STACK.empty())
-	{
-		const Point_2d _pt_top = FLOOD_STACK.top();
-		FLOOD_STACK.pop();
-
-		const Pattern& p = mTilePalette.pattern();
-		mMap.getCellByGridCoords(_pt_top).index(layer, p.value(_pt_top.x() % p.width(), _pt_top.y() % p.height()));
-
-		for (int i = 0; i < 4; i++)
-		{
-			Point_2d coord(_pt_top.x() + dX[i], _pt_top.y() + dY[i]);
-			if (coord.x() >= 0 && coord.x() < mMap.width() && coord.y() >= 0 && coord.y() < mMap.height() && mMap.getCellByGridCoords(coord).index(layer) == seed_index)
-				FLOOD_STACK.push(coord);
-		}
-	}
-
+	mFloodFill.fill(mMap.field(), mUndo, layer, _pt, mTilePalette.pattern());
 }
 
 
@@ -686,10 +806,10 @@ void EditorState::pattern(Cell::TileLayer layer, int value)
 			int x = _pt.x() - ((_p->width() - 1) - col);
 			int y = _pt.y() - ((_p->height() - 1) - row);
 
-			if (x >= 0 && y >= 0)
+			if (x >= 0 && y >= 0 && x < mMap.width() && y < mMap.height())
 			{
-				if (value >= 0) mMap.getCellByGridCoords(x, y).index(layer, _p->value(col, row));
-				else mMap.getCellByGridCoords(x, y).index(layer, -1);
+				if (value >= 0) mUndo.index(layer, x, y, _p->value(col, row));
+				else mUndo.index(layer, x, y, -1);
 			}
 		}
 	}
@@ -714,8 +834,8 @@ void EditorState::pattern_collision()
 			int x = _pt.x() - ((_p.width() - 1) - col);
 			int y = _pt.y() - ((_p.height() - 1) - row);
 
-			if (x >= 0 && y >= 0)
-				mMap.getCellByGridCoords(x, y).blocked(mPlacingCollision);
+			if (x >= 0 && y >= 0 && x < mMap.width() && y < mMap.height())
+				mUndo.blocked(x, y, mPlacingCollision);
 		}
 	}
 }
@@ -789,16 +909,85 @@ void EditorState::saveMap()
 		f.makeDirectory("maps");
 
 	mMap.name(mToolBar.map_name());
-	mMap.save(mMapSavePath);
+	queueSave(mMapSavePath);
+
+	mAutosaveRevision = mMap.field().revision();
+	mAutosaveTimer.reset();
+}
+
+
+/**
+ * Saves the map next to its save path, e.g. maps/town.autosave.xml for
+ * maps/town.xml, if anything changed since it was last saved.
+ * 
+ * \note	Skipped while a save is still being written so a slow disk can't
+ *			pile up snapshots.
+ */
+void EditorState::autosave()
+{
+	if (mPendingSaves > 0 || mMap.field().revision() == mAutosaveRevision)
+		return;
+
+	std::string path = mMapSavePath;
+	size_t extension = path.find_last_of('.');
+	if (extension == std::string::npos || path.find_first_of('/', extension) != std::string::npos)
+		path += AUTOSAVE_SUFFIX;
+	else
+		path.insert(extension, AUTOSAVE_SUFFIX);
+
+	mMap.name(mToolBar.map_name());
+	queueSave(path);
+
+	mAutosaveRevision = mMap.field().revision();
 }
 
 
 /**
- * Saves and undo level.
+ * Renders the whole map to a PNG next to its save path, e.g. maps/town.png
+ * for maps/town.xml, on the save thread.
  */
-void EditorState::saveUndo()
+void EditorState::dumpMap()
 {
-	mFieldUndo = mMap.field();
+	std::string path = mMapSavePath;
+	size_t extension = path.find_last_of('.');
+	if (extension != std::string::npos && path.find_first_of('/', extension) == std::string::npos)
+		path.erase(extension);
+	path += ".png";
+
+	std::shared_ptr<MapSnapshot> snapshot = std::make_shared<MapSnapshot>(mMap.snapshot());
+	const Tileset* tileset = &mMap.tileset();
+	std::atomic<int>* pendingSaves = &mPendingSaves;
+
+	mPendingSaves++;
+	mSaveThread.enqueue([snapshot, tileset, path, pendingSaves]
+	{
+		if (Map::dump(*snapshot, *tileset, path))
+			cout << "Map rendered to '" << path << "'." << endl;
+		else
+			cout << "Unable to render map to '" << path << "'." << endl;
+
+		(*pendingSaves)--;
+	});
+}
+
+
+/**
+ * Takes a snapshot of the map and hands it to the save thread to be
+ * serialized and written while editing carries on.
+ */
+void EditorState::queueSave(const std::string& path)
+{
+	std::shared_ptr<MapSnapshot> snapshot = std::make_shared<MapSnapshot>(mMap.snapshot());
+	std::atomic<int>* pendingSaves = &mPendingSaves;
+
+	mPendingSaves++;
+	mSaveThread.enqueue([snapshot, path, pendingSaves]
+	{
+		if (!Map::save(*snapshot, path))
+			cout << "Unable to save map '" << path << "'." << endl;
+
+		(*pendingSaves)--;
+	});
 }
 
 
@@ -831,6 +1020,8 @@ void EditorState::restorePreviousState()
  */
 void EditorState::debug()
 {
+	ScopedTimer timer(STAGE_TEXT);
+
 	Renderer& r = Utility<Renderer>::get();
 
 	// Cell coords pointed at by mouse.
@@ -846,7 +1037,7 @@ void EditorState::debug()
 	r.drawTextShadow(mFont, ss.str(), 4, 115, 1, 255, 255, 255, 0, 0, 0);
 
 	// Tile Index
-	Cell& cell = mMap.getCell(mMouseCoords);
+	Cell cell = mMap.getCell(mMouseCoords);
 
 	ss.str("");
 	ss << "Base: " << cell.index(Cell::LAYER_BASE);
@@ -876,7 +1067,39 @@ void EditorState::debug()
 	ss << "Destination: " << cell.link_destination().x() << ", " << cell.link_destination().y();
 	r.drawTextShadow(mFont, ss.str(), 4, 250, 1, 255, 255, 255, 0, 0, 0);
 
-	mMap.tileset().drawTileColorPalette(r.width() - 32, 50, 4, 6);
+	// Heap allocations. The map render path should always read 0.
+	ss.str("");
+	ss << "Allocations/Frame: " << mFrameAllocations;
+	r.drawTextShadow(mFont, ss.str(), 4, 280, 1, 255, 255, 255, 0, 0, 0);
+
+	ss.str("");
+	ss << "Field Memory: " << mMap.field().allocatedBytes() / 1024 << " KB";
+	r.drawTextShadow(mFont, ss.str(), 4, 265, 1, 255, 255, 255, 0, 0, 0);
+
+	ss.str("");
+	ss << "Undo: " << mUndo.size() << " entries, " << mUndo.memoryUsed() / 1024 << " KB";
+	r.drawTextShadow(mFont, ss.str(), 4, 310, 1, 255, 255, 255, 0, 0, 0);
+
+	ss.str("");
+	ss << "Batch Memory: " << mMap.batchBytes() / 1024 << " KB";
+	r.drawTextShadow(mFont, ss.str(), 4, 325, 1, 255, 255, 255, 0, 0, 0);
+
+	ss.str("");
+	ss << "Map Allocations/Frame: " << mMapAllocations;
+	mMapAllocations > 0 ? r.drawTextShadow(mFont, ss.str(), 4, 295, 1, 255, 0, 0, 0, 0, 0) : r.drawTextShadow(mFont, ss.str(), 4, 295, 1, 255, 255, 255, 0, 0, 0);
+
+	// Stage timings over the last few hundred frames. F9 saves them all.
+	const FrameProfiler& profiler = Utility<FrameProfiler>::get();
+
+	ss.str("");
+	ss << "Stage Times (ms) over " << profiler.frames() << " frames: p50 / p95 / p99 / max";
+	r.drawTextShadow(mFont, ss.str(), 4, 355, 1, 255, 255, 255, 0, 0, 0);
+
+	for(int stage = 0; stage < STAGE_COUNT; stage++)
+	{
+		FrameProfiler::Summary s = profiler.summary(static_cast<FrameStage>(stage));
+		r.drawTextShadow(mFont, string_format("%s: %.2f / %.2f / %.2f / %.2f", FrameProfiler::stageName(static_cast<FrameStage>(stage)), s.p50, s.p95, s.p99, s.max), 4, 370 + stage * 15, 1, 255, 255, 255, 0, 0, 0);
+	}
 }
 
 
@@ -885,7 +1108,7 @@ void EditorState::debug()
  */
 void EditorState::instructions()
 {
-	string str1 = "F1: Show/Hide Debug | F3: Map Link | F4: Save | F5: BG Detail | F6: Detail | F7: Foreground | F10: Hide/Show UI";
+	string str1 = "F1: Show/Hide Debug | F2: Render Map | F3: Map Link | F4: Save | F5: BG Detail | F6: Detail | F7: Foreground | F8: Start/Stop Trace | F9: Save Stage Times | F10: Hide/Show UI";
 	Utility<Renderer>::get().drawTextShadow(mFont, str1, Utility<Renderer>::get().width() - mFont.width(str1) - 4, 4, 1, 255, 255, 255, 0, 0, 0);
 }
 
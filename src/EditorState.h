@@ -2,14 +2,18 @@
 
 #include "NAS2D/NAS2D.h"
 
+#include "FloodFill.h"
 #include "Menu.h"
 #include "MiniMap.h"
 #include "TilePalette.h"
 #include "ToolBar.h"
+#include "ThreadPool.h"
+#include "UndoJournal.h"
 
 #include "Map/Entity.h"
 #include "Map/Map.h"
 
+#include <atomic>
 #include <string>
 #include <map>
 
@@ -41,7 +45,7 @@ enum HandleCorner
 class EditorState: public State
 {
 public:
-	EditorState(const std::string& mapPath);
+	EditorState(Map&& map, const std::string& mapPath);
 	EditorState(const std::string& name, const std::string& mapPath, const std::string& tsetPath, int width, int height);
 
 	~EditorState();
@@ -68,6 +72,8 @@ private:
 
 	void initUi();
 
+	size_t undoBudget() const;
+
 	void button_MapLinkOkay_Click();
 	void button_MapLinkCancel_Click();
 	
@@ -75,6 +81,9 @@ private:
 	void updateSelector();
 
 	void saveMap();
+	void autosave();
+	void queueSave(const std::string& path);
+	void dumpMap();
 
 	void debug();
 	void instructions();
@@ -82,14 +91,12 @@ private:
 	void changeTileTexture();
 	void pattern(Cell::TileLayer layer, int value = 0);
 	void patternFill(Cell::TileLayer layer);
-	void patternFill_Contig(Cell::TileLayer layer, const Point_2d& _pt, int seed_index);
+	void patternFill_Contig(Cell::TileLayer layer, const Point_2d& _pt);
 
 	void pattern_collision();
 
 	void handleLeftButtonDown(int x, int y);
 
-	void saveUndo();
-
 	void setState(EditState state);
 	void restorePreviousState();
 
@@ -101,6 +108,7 @@ private:
 
 	// RESOURCES
 	Timer			mTimer;
+	Timer			mAutosaveTimer;
 
 	Font			mFont;
 
@@ -119,6 +127,8 @@ private:
 	Rectangle_2d	mSelectorRect;
 	Rectangle_2d	mCellInspectRect;
 
+	TileBatch		mOverlay;				/**< Selector and link edit overlays, gathered over a frame and drawn at once. */
+
 	// UI ELEMENTS
 	TilePalette		mTilePalette;
 	ToolBar			mToolBar;
@@ -132,15 +142,25 @@ private:
 	TextField		mTxtLinkDestY;
 
 	// MAP CONTROLS
-	Cell*			mLinkCell;
-	GameField		mFieldUndo;
+	Cell			mLinkCell;
 	Map				mMap;
+	UndoJournal		mUndo;
+	FloodFill		mFloodFill;
 
 	std::string		mMapSavePath;
 
+	unsigned int		mAutosaveRevision;		/**< Field revision as of the last save or autosave. */
+	std::atomic<int>	mPendingSaves;			/**< Saves queued or being written. */
+	ThreadPool			mSaveThread;			/**< Single worker that serializes and writes map snapshots, in order. Declared after everything its tasks touch. */
+
 	EditState		mEditState;
 	EditState		mPreviousEditState;
 
+	// DEBUG
+	size_t			mAllocationCount;		/**< Heap allocation count at the start of the last frame. */
+	size_t			mFrameAllocations;		/**< Heap allocations made during the last frame. */
+	size_t			mMapAllocations;		/**< Heap allocations made by the map render path during the last frame. */
+
 	// FLAGS
 	bool			mDrawDebug;
 	bool			mLeftButtonDown;
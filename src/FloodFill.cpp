@@ -0,0 +1,149 @@
+#include "FloodFill.h"
+
+#include "TraceRecorder.h"
+
+#include <algorithm>
+
+
+/**
+ * C'tor
+ */
+FloodFill::FloodFill():	mWidth(0)
+{}
+
+
+/**
+ * Fills the contiguous area of cells on a layer that share the seed cell's
+ * index with a pattern. The pattern is tiled from the origin of the field.
+ * 
+ * \return	Number of cells filled.
+ */
+int FloodFill::fill(GameField& field, UndoJournal& journal, Cell::TileLayer layer, const Point_2d& seed, const Pattern& pattern)
+{
+	TraceScope trace("FloodFill::fill", "edit");
+
+	mFilledArea = Rectangle_2d();
+
+	if (seed.x() < 0 || seed.y() < 0 || seed.x() >= field.width() || seed.y() >= field.height())
+		return 0;
+
+	int index = field.index(layer, seed.x(), seed.y());
+
+	// A 1x1 pattern with the seed's index wouldn't change anything.
+	if (pattern.width() == 1 && pattern.height() == 1 && pattern.value(0, 0) == index)
+		return 0;
+
+	mWidth = field.width();
+	mVisited.assign((field.width() * field.height() + 7) / 8, 0);
+	mStack.clear();
+
+	int minX = seed.x(), minY = seed.y(), maxX = seed.x(), maxY = seed.y();
+	int count = 0;
+
+	Span seedSpan = { seed.x(), seed.x(), seed.y() };
+	mStack.push_back(seedSpan);
+
+	while (!mStack.empty())
+	{
+		Span _s = mStack.back();
+		mStack.pop_back();
+
+		int x = _s.x1;
+		while (x <= _s.x2)
+		{
+			if (!fillable(field, layer, x, _s.y, index))
+			{
+				++x;
+				continue;
+			}
+
+			// Grow the run in both directions as far as it goes.
+			int x1 = x, x2 = x;
+			while (x1 > 0 && fillable(field, layer, x1 - 1, _s.y, index))
+				--x1;
+			while (x2 < field.width() - 1 && fillable(field, layer, x2 + 1, _s.y, index))
+				++x2;
+
+			for (int i = x1; i <= x2; ++i)
+				visit(i, _s.y);
+
+			fillRun(field, journal, layer, x1, x2, _s.y, pattern);
+
+			if (_s.y > 0)
+				scanRow(field, layer, x1, x2, _s.y - 1, index);
+			if (_s.y < field.height() - 1)
+				scanRow(field, layer, x1, x2, _s.y + 1, index);
+
+			count += x2 - x1 + 1;
+			minX = std::min(minX, x1);
+			maxX = std::max(maxX, x2);
+			minY = std::min(minY, _s.y);
+			maxY = std::max(maxY, _s.y);
+
+			x = x2 + 2;
+		}
+	}
+
+	mFilledArea = Rectangle_2d(minX, minY, maxX - minX + 1, maxY - minY + 1);
+
+	return count;
+}
+
+
+/**
+ * Writes pattern values to a run of cells, one chunk row at a time. Spans
+ * are only made writable once something in them changes, the same as
+ * EditorState::patternFill().
+ */
+void FloodFill::fillRun(GameField& field, UndoJournal& journal, Cell::TileLayer layer, int x1, int x2, int y, const Pattern& pattern)
+{
+	int patternRow = y % pattern.height();
+
+	for (int x = x1; x <= x2; )
+	{
+		const GameField::TileIndex* current = field.span(layer, x, y);
+		GameField::TileIndex* indices = nullptr;
+
+		int count = std::min(GameField::spanLength(x), x2 - x + 1);
+		for (int i = 0; i < count; i++, x++)
+		{
+			int value = pattern.value(x % pattern.width(), patternRow);
+			if (current[i] == value)
+				continue;
+
+			if (!indices)
+			{
+				indices = field.writableSpan(layer, x - i, y);
+				current = indices;
+			}
+
+			journal.record(layer, x, y, indices[i], value);
+			indices[i] = static_cast<GameField::TileIndex>(value);
+		}
+	}
+}
+
+
+/**
+ * Pushes every fillable run of a row between x1 and x2 onto the stack.
+ * Runs are grown to their full extent when they're popped.
+ */
+void FloodFill::scanRow(const GameField& field, Cell::TileLayer layer, int x1, int x2, int y, int index)
+{
+	int x = x1;
+	while (x <= x2)
+	{
+		if (!fillable(field, layer, x, y, index))
+		{
+			++x;
+			continue;
+		}
+
+		int start = x;
+		while (x <= x2 && fillable(field, layer, x, y, index))
+			++x;
+
+		Span _s = { start, x - 1, y };
+		mStack.push_back(_s);
+	}
+}
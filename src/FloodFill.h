@@ -0,0 +1,62 @@
+#pragma once
+
+#include "NAS2D/NAS2D.h"
+
+#include "Pattern.h"
+#include "UndoJournal.h"
+
+#include "Map/GameField.h"
+
+#include <vector>
+
+using namespace NAS2D;
+
+/**
+ * \class FloodFill
+ * \brief Scanline flood fill for a single GameField layer.
+ * 
+ * Fills whole row runs at a time instead of pushing every neighbor of every
+ * filled cell. A visited bitmap ensures no cell is examined twice, even when
+ * the fill pattern contains the index being replaced.
+ * 
+ * All writes go through an UndoJournal so a fill is recorded like any other
+ * edit. The area touched by the last fill is available afterwards so that
+ * the minimap and friends can update just that region.
+ */
+class FloodFill
+{
+public:
+
+	FloodFill();
+
+	int fill(GameField& field, UndoJournal& journal, Cell::TileLayer layer, const Point_2d& seed, const Pattern& pattern);
+
+	const Rectangle_2d& filledArea() const { return mFilledArea; }
+
+private:
+
+	/**
+	 * Row run waiting to be scanned for seed cells.
+	 */
+	struct Span
+	{
+		int		x1;
+		int		x2;
+		int		y;
+	};
+
+	bool visited(int x, int y) const { int i = y * mWidth + x; return (mVisited[i >> 3] & (1 << (i & 7))) != 0; }
+	void visit(int x, int y) { int i = y * mWidth + x; mVisited[i >> 3] |= (1 << (i & 7)); }
+
+	bool fillable(const GameField& field, Cell::TileLayer layer, int x, int y, int index) const { return !visited(x, y) && field.index(layer, x, y) == index; }
+
+	void fillRun(GameField& field, UndoJournal& journal, Cell::TileLayer layer, int x1, int x2, int y, const Pattern& pattern);
+	void scanRow(const GameField& field, Cell::TileLayer layer, int x1, int x2, int y, int index);
+
+	std::vector<Span>			mStack;			/**< Runs waiting to be scanned. Kept between fills to avoid reallocating. */
+	std::vector<unsigned char>	mVisited;		/**< Visited bitmap, one bit per cell. */
+
+	Rectangle_2d				mFilledArea;	/**< Area touched by the last fill, in cells. */
+
+	int							mWidth;			/**< Width of the field being filled. */
+};
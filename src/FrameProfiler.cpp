@@ -0,0 +1,135 @@
+#include "FrameProfiler.h"
+
+#include "Common.h"
+
+#include "NAS2D/NAS2D.h"
+
+#include <algorithm>
+
+using namespace NAS2D;
+
+
+const char* STAGE_NAMES[STAGE_COUNT] =
+{
+	"Map Below",
+	"Entities",
+	"Map Above",
+	"MiniMap",
+	"Tile Palette",
+	"Tool Bar",
+	"Text",
+	"Frame"
+};
+
+
+/**
+ * C'tor
+ */
+FrameProfiler::FrameProfiler():	mSamples(FRAME_COUNT * STAGE_COUNT, 0.0f),
+								mCurrent(0),
+								mFrames(0),
+								mStarted(false)
+{
+	mScratch.reserve(FRAME_COUNT);
+}
+
+
+/**
+ * Ends the frame being recorded and starts the next. Call once at the very
+ * beginning of every frame.
+ */
+void FrameProfiler::beginFrame()
+{
+	Clock::time_point now = Clock::now();
+
+	if (mStarted)
+	{
+		add(STAGE_FRAME, now - mFrameStart);
+
+		mCurrent = (mCurrent + 1) % FRAME_COUNT;
+		if (mFrames < FRAME_COUNT)
+			mFrames++;
+	}
+
+	std::fill(mSamples.begin() + mCurrent * STAGE_COUNT, mSamples.begin() + (mCurrent + 1) * STAGE_COUNT, 0.0f);
+
+	mFrameStart = now;
+	mStarted = true;
+}
+
+
+/**
+ * Gets the median, 95th and 99th percentile and maximum time of a stage
+ * over the recorded frames. The frame being recorded isn't included.
+ */
+FrameProfiler::Summary FrameProfiler::summary(FrameStage stage) const
+{
+	Summary s;
+	if (mFrames == 0)
+		return s;
+
+	mScratch.clear();
+	for (size_t age = 1; age <= mFrames; age++)
+		mScratch.push_back(mSamples[frameOffset(age) + stage]);
+
+	std::sort(mScratch.begin(), mScratch.end());
+
+	s.p50 = mScratch[(mScratch.size() - 1) * 50 / 100];
+	s.p95 = mScratch[(mScratch.size() - 1) * 95 / 100];
+	s.p99 = mScratch[(mScratch.size() - 1) * 99 / 100];
+	s.max = mScratch.back();
+
+	return s;
+}
+
+
+/**
+ * Writes the recorded frames, oldest first, to a CSV file with one row per
+ * frame and one column of milliseconds per stage.
+ */
+bool FrameProfiler::writeCsv(const std::string& path) const
+{
+	return writeFileAtomic(path, [this](std::ostream& stream)
+	{
+		stream << "frame";
+		for (int stage = 0; stage < STAGE_COUNT; stage++)
+			stream << "," << STAGE_NAMES[stage];
+		stream << "\n";
+
+		for (size_t age = mFrames; age > 0; age--)
+		{
+			stream << mFrames - age;
+			for (int stage = 0; stage < STAGE_COUNT; stage++)
+				stream << "," << mSamples[frameOffset(age) + stage];
+			stream << "\n";
+		}
+
+		return stream.good();
+	});
+}
+
+
+/**
+ * Gets the display name of a stage.
+ */
+const char* FrameProfiler::stageName(FrameStage stage)
+{
+	return STAGE_NAMES[stage];
+}
+
+
+/**
+ * C'tor
+ */
+ScopedTimer::ScopedTimer(FrameStage stage):	mStage(stage),
+											mStart(FrameProfiler::Clock::now())
+{}
+
+
+/**
+ * D'tor
+ */
+ScopedTimer::~ScopedTimer()
+{
+	Utility<FrameProfiler>::get().add(mStage, FrameProfiler::Clock::now() - mStart);
+}
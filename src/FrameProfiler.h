@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Stages of a frame that are timed by the FrameProfiler.
+ */
+enum FrameStage
+{
+	STAGE_MAP_BELOW,		/**< Map layers below entities. */
+	STAGE_ENTITIES,			/**< Entity updates and drawing. */
+	STAGE_MAP_ABOVE,		/**< Foreground layer and overlays. */
+	STAGE_MINIMAP,			/**< MiniMap::update(). */
+	STAGE_TILE_PALETTE,		/**< TilePalette::update(). */
+	STAGE_TOOLBAR,			/**< ToolBar::update(). */
+	STAGE_TEXT,				/**< Text drawn by the editor itself. */
+	STAGE_FRAME,			/**< Whole frame, from one beginFrame() to the next. */
+	STAGE_COUNT
+};
+
+
+/**
+ * \class FrameProfiler
+ * \brief Keeps the time spent in each stage of the last FRAME_COUNT frames.
+ *
+ * Stages are timed with ScopedTimer. A stage can be timed any number of
+ * times within a frame, the times add up. Samples are kept in a ring buffer
+ * so summarizing and dumping only ever look at recent frames.
+ *
+ * Get at the profiler through Utility<FrameProfiler>::get().
+ *
+ * \note	Not thread safe. Only stages on the main thread are timed.
+ */
+class FrameProfiler
+{
+public:
+
+	static const size_t FRAME_COUNT = 600;
+
+	/**
+	 * Distribution of a stage's time over the recorded frames, in
+	 * milliseconds.
+	 */
+	struct Summary
+	{
+		Summary(): p50(0.0f), p95(0.0f), p99(0.0f), max(0.0f) {}
+
+		float	p50;
+		float	p95;
+		float	p99;
+		float	max;
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+public:
+
+	FrameProfiler();
+
+	void beginFrame();
+
+	void add(FrameStage stage, Clock::duration time) { mSamples[mCurrent * STAGE_COUNT + stage] += std::chrono::duration<float, std::milli>(time).count(); }
+
+	size_t frames() const { return mFrames; }
+
+	Summary summary(FrameStage stage) const;
+
+	bool writeCsv(const std::string& path) const;
+
+	static const char* stageName(FrameStage stage);
+
+private:
+
+	FrameProfiler(const FrameProfiler&);				// Explicitly disallowed
+	FrameProfiler& operator=(const FrameProfiler&);		// Explicitly disallowed
+
+	size_t frameOffset(size_t age) const { return ((mCurrent + FRAME_COUNT - age) % FRAME_COUNT) * STAGE_COUNT; }
+
+	std::vector<float>			mSamples;		/**< Milliseconds per stage, STAGE_COUNT floats per frame. */
+	mutable std::vector<float>	mScratch;		/**< Reused by summary() so that showing the overlay doesn't allocate. */
+
+	size_t						mCurrent;		/**< Frame in mSamples being recorded. */
+	size_t						mFrames;		/**< Number of complete frames recorded, up to FRAME_COUNT. */
+
+	Clock::time_point			mFrameStart;	/**< Time the current frame began. */
+	bool						mStarted;		/**< Whether beginFrame() has been called yet. */
+};
+
+
+/**
+ * \class ScopedTimer
+ * \brief Adds the time between its construction and destruction to a stage
+ *		  of the current frame.
+ */
+class ScopedTimer
+{
+public:
+
+	explicit ScopedTimer(FrameStage stage);
+	~ScopedTimer();
+
+private:
+
+	ScopedTimer(const ScopedTimer&);				// Explicitly disallowed
+	ScopedTimer& operator=(const ScopedTimer&);		// Explicitly disallowed
+
+	FrameStage							mStage;		/**< Stage being timed. */
+	FrameProfiler::Clock::time_point	mStart;		/**< Time the timer was constructed. */
+};
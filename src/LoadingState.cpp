@@ -0,0 +1,164 @@
+#include "LoadingState.h"
+
+#include "EditorState.h"
+#include "StartState.h"
+#include "TraceRecorder.h"
+
+#include <iostream>
+
+
+const int PROGRESS_BAR_WIDTH	= 400;
+const int PROGRESS_BAR_HEIGHT	= 20;
+
+
+/**
+ * Gets a human readable description of a loading stage.
+ */
+const std::string& stageText(LoadProgress::Stage stage)
+{
+	static const std::string READING = "READING MAP";
+	static const std::string TILESET = "LOADING TILESET";
+	static const std::string DONE = "FINISHING UP";
+
+	switch (stage)
+	{
+	case LoadProgress::STAGE_READING:
+		return READING;
+	case LoadProgress::STAGE_TILESET:
+		return TILESET;
+	default:
+		return DONE;
+	}
+}
+
+
+/**
+ * C'tor
+ */
+LoadingState::LoadingState(const std::string& mapPath):	mFont("fonts/ui-normal.png", 7, 9, 0),
+														mMapPath(mapPath),
+														mDone(false),
+														mQuit(false)
+{}
+
+
+/**
+ * D'tor
+ * 
+ * \note	If the state is torn down while still loading the load is cancelled
+ *			and waited for, the loading thread must never outlive the state.
+ */
+LoadingState::~LoadingState()
+{
+	mProgress.cancel();
+
+	if (mThread.joinable())
+		mThread.join();
+
+	EventHandler& e = Utility<EventHandler>::get();
+	e.keyDown().Disconnect(this, &LoadingState::onKeyDown);
+	e.quit().Disconnect(this, &LoadingState::onQuit);
+}
+
+
+void LoadingState::initialize()
+{
+	EventHandler& e = Utility<EventHandler>::get();
+	e.keyDown().Connect(this, &LoadingState::onKeyDown);
+	e.quit().Connect(this, &LoadingState::onQuit);
+
+	mThread = std::thread(&LoadingState::load, this);
+}
+
+
+/**
+ * Loading thread entry point.
+ */
+void LoadingState::load()
+{
+	TraceRecorder::nameThread("Map loader");
+
+	try
+	{
+		mMap.reset(new Map(mMapPath, &mProgress));
+
+		for (size_t i = 0; i < mMap->loadErrors().size(); i++)
+			std::cout << mMap->loadErrors()[i] << std::endl;
+	}
+	catch (Exception& e)
+	{
+		mError = e.getDescription();
+	}
+	catch (std::exception& e)
+	{
+		mError = e.what();
+	}
+
+	mDone = true;
+}
+
+
+/**
+ * Joins the loading thread and picks the State to go to next.
+ */
+State* LoadingState::finish()
+{
+	mThread.join();
+
+	if (mQuit)
+		return nullptr;
+
+	if (!mError.empty())
+	{
+		setMessage("COULDN'T LOAD MAP: " + mError);
+		return new StartState();
+	}
+
+	if (mProgress.cancelled() || !mMap)
+		return new StartState();
+
+	return new EditorState(std::move(*mMap), mMapPath);
+}
+
+
+State* LoadingState::update()
+{
+	TraceRecorder::instant("Frame", "frame");
+
+	if (mDone)
+		return finish();
+
+	Renderer& r = Utility<Renderer>::get();
+	r.clearScreen(COLOR_BLACK);
+
+	int x = static_cast<int>(r.width() / 2) - PROGRESS_BAR_WIDTH / 2;
+	int y = static_cast<int>(r.height() / 2) - PROGRESS_BAR_HEIGHT / 2;
+
+	r.drawText(mFont, mProgress.cancelled() ? "CANCELLING..." : stageText(mProgress.stage()), static_cast<float>(x), static_cast<float>(y - 15), 255, 255, 0);
+	r.drawBoxFilled(static_cast<float>(x), static_cast<float>(y), PROGRESS_BAR_WIDTH * mProgress.progress(), PROGRESS_BAR_HEIGHT, 0, 120, 255);
+	r.drawBox(static_cast<float>(x), static_cast<float>(y), PROGRESS_BAR_WIDTH, PROGRESS_BAR_HEIGHT, 255, 255, 255);
+	r.drawText(mFont, mMapPath, static_cast<float>(x), static_cast<float>(y + PROGRESS_BAR_HEIGHT + 5), 255, 255, 255);
+	r.drawText(mFont, "ESC to cancel", static_cast<float>(x), static_cast<float>(y + PROGRESS_BAR_HEIGHT + 20), 200, 200, 200);
+
+	return this;
+}
+
+
+/**
+ * Key Down handler.
+ */
+void LoadingState::onKeyDown(KeyCode key, KeyModifier mod, bool repeat)
+{
+	if (key == KEY_ESCAPE)
+		mProgress.cancel();
+}
+
+
+/**
+ * Quit handler.
+ */
+void LoadingState::onQuit()
+{
+	mQuit = true;
+	mProgress.cancel();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "NAS2D/NAS2D.h"
+
+#include "Map/LoadProgress.h"
+#include "Map/Map.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+
+using namespace std;
+using namespace NAS2D;
+
+
+/**
+ * \class LoadingState
+ * \brief Loads a Map on a worker thread while showing its progress.
+ * 
+ * Hands the loaded Map to an EditorState when it's done or goes back
+ * to the StartState if loading failed or was cancelled.
+ */
+class LoadingState: public State
+{
+public:
+
+	LoadingState(const std::string& mapPath);
+	~LoadingState();
+
+protected:
+
+	void initialize();
+
+	State* update();
+
+	void onKeyDown(KeyCode key, KeyModifier mod, bool repeat);
+
+	void onQuit();
+
+private:
+
+	LoadingState();									// Explicitly undefined
+	LoadingState(const LoadingState&);				// Explicitly disallowed
+	LoadingState& operator=(const LoadingState&);	// Explicitly disallowed
+
+	void load();
+	State* finish();
+
+	Font				mFont;			/**< Internal Font to use. */
+
+	std::string			mMapPath;		/**< Path to the map being loaded. */
+	std::string			mError;			/**< Description of the error that stopped the load, if any. */
+
+	std::unique_ptr<Map>	mMap;		/**< Map being loaded. Only touched by the loading thread until mDone is set. */
+
+	LoadProgress		mProgress;		/**< Progress of the load, shared with the loading thread. */
+	std::thread			mThread;		/**< Loading thread. */
+	std::atomic<bool>	mDone;			/**< Set by the loading thread when it's finished. */
+
+	bool				mQuit;			/**< Set when the application was asked to quit. */
+};
@@ -1,104 +1,105 @@
 #include "Cell.h"
 
+#include "GameField.h"
+
 
 /**
  * C'tor
  */
-Cell::Cell():	mLinkX(0),
-				mLinkY(0),
-				mBaseIndex(0),
-				mBaseDetailIndex(EMPTY_INDEX),
-				mDetailIndex(EMPTY_INDEX),
-				mFgIndex(EMPTY_INDEX),
-				mBlocked(false)
+Cell::Cell():	mField(nullptr),
+				mX(0),
+				mY(0)
 {}
 
 
 /**
  * C'tor
  */
-Cell::Cell(int baseIndex, int baseDetailIndex, int detailIndex, int fgIndex, bool blocked):		mLinkX(0),
-																								mLinkY(0),
-																								mBaseIndex(baseIndex),
-																								mBaseDetailIndex(baseDetailIndex),
-																								mDetailIndex(detailIndex),
-																								mFgIndex(fgIndex),
-																								mBlocked(blocked)
+Cell::Cell(GameField* field, int x, int y):	mField(field),
+											mX(x),
+											mY(y)
 {}
 
 
 /**
- * 
+ * Gets the tile index of a given layer.
  */
 int Cell::index(TileLayer layer) const
 {
-	switch(layer)
-	{
-		case LAYER_BASE:
-			return mBaseIndex;
-			break;
-
-		case LAYER_BASE_DETAIL:
-			return mBaseDetailIndex;
-			break;
-
-		case LAYER_DETAIL:
-			return mDetailIndex;
-			break;
-
-		case LAYER_FOREGROUND:
-			return mFgIndex;
-			break;
-
-		default:
-			return 0;
-			break;
-	}
+	return mField->index(layer, mX, mY);
 }
 
 
 /**
- * 
+ * Sets the tile index of a given layer.
  */
 void Cell::index(TileLayer layer, int index)
 {
-	switch(layer)
-	{
-		case LAYER_BASE:
-			mBaseIndex = index;
-			break;
-
-		case LAYER_BASE_DETAIL:
-			mBaseDetailIndex = index;
-			break;
-
-		case LAYER_DETAIL:
-			mDetailIndex = index;
-			break;
-
-		case LAYER_FOREGROUND:
-			mFgIndex = index;
-			break;
-
-		default:
-			break;
-	}
+	mField->index(layer, mX, mY, index);
 }
 
 
 /**
- * 
+ * Gets whether or not the Cell can be walked on.
  */
 bool Cell::blocked() const
 {
-	return mBlocked;
+	return mField->blocked(mX, mY);
 }
 
 
 /**
- * 
+ * Sets whether or not the Cell can be walked on.
  */
 void Cell::blocked(bool blocked)
 {
-	mBlocked = blocked;
-}
\ No newline at end of file
+	mField->blocked(mX, mY, blocked);
+}
+
+
+/**
+ * Gets whether the Cell links to another map.
+ */
+bool Cell::linked() const
+{
+	return !mField->link(mX, mY).empty();
+}
+
+
+/**
+ * Gets the position within the destination map that this Cell links to.
+ */
+Point_2d Cell::link_destination() const
+{
+	return mField->linkDestination(mX, mY);
+}
+
+
+/**
+ * Sets the position within the destination map that this Cell links to.
+ * 
+ * \note	Has no effect if the Cell isn't linked.
+ */
+void Cell::link_destination(const Point_2d& pt)
+{
+	mField->link(mX, mY, mField->link(mX, mY), pt);
+}
+
+
+/**
+ * Gets the name of the map this Cell links to.
+ */
+const std::string& Cell::link() const
+{
+	return mField->link(mX, mY);
+}
+
+
+/**
+ * Sets the name of the map this Cell links to. An empty string
+ * removes the link.
+ */
+void Cell::link(const std::string& link)
+{
+	mField->link(mX, mY, link, mField->linkDestination(mX, mY));
+}
@@ -7,8 +7,19 @@
 
 using namespace NAS2D;
 
+class GameField;
+
 /**
+ * \class Cell
+ * \brief Lightweight handle to a single cell of a GameField.
+ * 
+ * Cell doesn't own any tile data. The GameField stores its layers in
+ * chunks of CHUNK_SIZE x CHUNK_SIZE cells, each layer a contiguous array
+ * within its chunk, and a Cell simply refers back into the field by
+ * coordinate so it can be passed around by value at no real cost.
  * 
+ * \note	A default constructed Cell doesn't refer to any GameField. Use
+ *			valid() to check before using it.
  */
 class Cell
 {
@@ -22,10 +33,11 @@ public:
 		LAYER_FOREGROUND
 	};
 
+	static const int LAYER_COUNT = 4;
 	static const int EMPTY_INDEX = -1;
 
 	Cell();
-	Cell(int baseIndex, int baseDetailIndex, int detailIndex, int fgIndex, bool blocked);
+	Cell(GameField* field, int x, int y);
 
 	int index(TileLayer layer = LAYER_BASE) const;
 	void index(TileLayer layer, int index);
@@ -33,28 +45,26 @@ public:
 	bool blocked() const;
 	void blocked(bool blocked);
 
-	bool linked() const { return !mLink.empty(); }
+	bool linked() const;
 
-	Point_2d link_destination() const { return Point_2d(mLinkX, mLinkY); }
-	void link_destination(const Point_2d& pt) { mLinkX = pt.x(); mLinkY = pt.y(); }
+	Point_2d link_destination() const;
+	void link_destination(const Point_2d& pt);
 
-	const std::string& link() const { return mLink; };
-	void link(const std::string& link) { mLink = link; }
+	const std::string& link() const;
+	void link(const std::string& link);
 
-private:
+	int x() const { return mX; }
+	int y() const { return mY; }
 
-	std::string		mLink;				/**< Map to link to. */
+	bool valid() const { return mField != nullptr; }
 
-	int				mLinkX;				/**<  */
-	int				mLinkY;				/**<  */
+private:
 
-	int				mBaseIndex;			/**< Tile index for the Sub-Background tile. */
-	int				mBaseDetailIndex;	/**< Tile index for the Background tile */
-	int				mDetailIndex;		/**< Tile index for the Detail tile. */
-	int				mFgIndex;			/**< Tile index for the Foreground index. */
+	GameField*		mField;				/**< GameField this Cell refers to. */
 
-	bool			mBlocked;			/**< Indicates that this tile can't be walked on. */
+	int				mX;					/**< X-Coordinate of the Cell in the GameField. */
+	int				mY;					/**< Y-Coordinate of the Cell in the GameField. */
 };
 
 
-#endif
\ No newline at end of file
+#endif
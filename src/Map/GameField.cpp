@@ -1,66 +1,462 @@
 #include "GameField.h"
 
+#include <algorithm>
+#include <cstring>
+
 
 /**
- * C'tor
+ * Rows of default values handed out as spans for unallocated layers.
  */
-GameField::GameField()
-{}
+struct DefaultRows
+{
+	DefaultRows()
+	{
+		for (int i = 0; i < Cell::LAYER_COUNT; i++)
+			std::fill(rows[i], rows[i] + GameField::CHUNK_SIZE, static_cast<GameField::TileIndex>(GameField::defaultIndex(static_cast<Cell::TileLayer>(i))));
+	}
+
+	GameField::TileIndex rows[Cell::LAYER_COUNT][GameField::CHUNK_SIZE];
+};
+
+
+static const GameField::TileIndex* defaultRow(Cell::TileLayer layer)
+{
+	static const DefaultRows DEFAULT_ROWS;
+	return DEFAULT_ROWS.rows[layer];
+}
 
 
 /**
  * C'tor
  */
-GameField::GameField(int width, int height)
+GameField::Chunk::Chunk(const Chunk& chunk)
 {
-	mField.resize(height);
+	for (int i = 0; i < Cell::LAYER_COUNT; i++)
+	{
+		if (chunk.layers[i])
+		{
+			layers[i].reset(new TileIndex[CHUNK_AREA]);
+			std::memcpy(layers[i].get(), chunk.layers[i].get(), CHUNK_AREA * sizeof(TileIndex));
+		}
+	}
 
-	for(size_t row = 0; row < mField.size(); row++)
+	if (chunk.collision)
 	{
-		mField[row].resize(width);
+		collision.reset(new unsigned char[COLLISION_BYTES]);
+		std::memcpy(collision.get(), chunk.collision.get(), COLLISION_BYTES);
 	}
 }
 
 
 /**
- * Returns a reference to a Cell object given an X/Y coordinate pair.
+ * Gets whether the chunk has nothing allocated.
+ */
+bool GameField::Chunk::empty() const
+{
+	for (int i = 0; i < Cell::LAYER_COUNT; i++)
+	{
+		if (layers[i])
+			return false;
+	}
+
+	return !collision;
+}
+
+
+/**
+ * C'tor
+ */
+GameField::GameField():	mWidth(0),
+						mHeight(0),
+						mChunksWide(0),
+						mChunksHigh(0),
+						mRevision(0)
+{}
+
+
+/**
+ * C'tor
+ */
+GameField::GameField(int width, int height):	mWidth(0),
+												mHeight(0),
+												mChunksWide(0),
+												mChunksHigh(0),
+												mRevision(0)
+{
+	resize(width, height);
+}
+
+
+/**
+ * Copy c'tor
+ */
+GameField::GameField(const GameField& field):	mWidth(0),
+												mHeight(0),
+												mChunksWide(0),
+												mChunksHigh(0),
+												mRevision(0)
+{
+	*this = field;
+}
+
+
+/**
+ * Copy assignment operator. Chunks are shared until either field writes to them.
+ */
+GameField& GameField::operator=(const GameField& field)
+{
+	if (this == &field)
+		return *this;
+
+	mWidth = field.mWidth;
+	mHeight = field.mHeight;
+	mChunksWide = field.mChunksWide;
+	mChunksHigh = field.mChunksHigh;
+	mLinks = field.mLinks;
+	mRevisions = field.mRevisions;
+	mRevision = field.mRevision;
+
+	mChunks = field.mChunks;
+
+	return *this;
+}
+
+
+/**
+ * Returns a handle to a Cell given an X/Y coordinate pair.
  * 
  * \warning	There is no error checking in this function. Asking for a cell
- *			out of range will throw an exception.
+ *			out of range will result in undefined behavior.
  */
-Cell& GameField::cell(int x, int y)
+Cell GameField::cell(int x, int y)
 {
-	return mField[y][x];
+	return Cell(this, x, y);
 }
 
 
 /**
- * Resizes a game field.
+ * Gets the tile index of a cell on a given layer.
  */
-void GameField::resize(int width, int height)
+int GameField::index(Cell::TileLayer layer, int x, int y) const
+{
+	const Chunk* _c = chunk(x, y);
+	if (!_c || !_c->layers[layer])
+		return defaultIndex(layer);
+
+	return _c->layers[layer][cellOffset(x, y)];
+}
+
+
+/**
+ * Sets the tile index of a cell on a given layer.
+ * 
+ * \note	Writing a layer's default value to an unallocated layer
+ *			doesn't allocate anything.
+ */
+void GameField::index(Cell::TileLayer layer, int x, int y, int index)
+{
+	const Chunk* _c = chunk(x, y);
+
+	if ((!_c || !_c->layers[layer]) && index == defaultIndex(layer))
+		return;
+
+	Chunk& _w = allocateChunk(x, y);
+	if (!_w.layers[layer])
+		allocateLayer(_w, layer);
+
+	touch(x, y);
+	_w.layers[layer][cellOffset(x, y)] = static_cast<TileIndex>(index);
+}
+
+
+/**
+ * Gets a read-only span of tile indices starting at X, Y. The span is valid
+ * for spanLength(x) entries.
+ * 
+ * \note	Never allocates. Unallocated layers return a span of default values.
+ */
+const GameField::TileIndex* GameField::span(Cell::TileLayer layer, int x, int y) const
+{
+	const Chunk* _c = chunk(x, y);
+	if (!_c || !_c->layers[layer])
+		return defaultRow(layer) + (x & CHUNK_MASK);
+
+	return &_c->layers[layer][cellOffset(x, y)];
+}
+
+
+/**
+ * Gets a writable span of tile indices starting at X, Y. The span is valid
+ * for spanLength(x) entries.
+ * 
+ * \note	Allocates the chunk and layer if they aren't already.
+ */
+GameField::TileIndex* GameField::writableSpan(Cell::TileLayer layer, int x, int y)
+{
+	Chunk& _c = allocateChunk(x, y);
+	touch(x, y);
+
+	TileIndex* layerData = _c.layers[layer] ? _c.layers[layer].get() : allocateLayer(_c, layer);
+	return &layerData[cellOffset(x, y)];
+}
+
+
+/**
+ * Gets whether a cell is blocked.
+ */
+bool GameField::blocked(int x, int y) const
+{
+	const Chunk* _c = chunk(x, y);
+	if (!_c || !_c->collision)
+		return false;
+
+	int i = cellOffset(x, y);
+	return (_c->collision[i >> 3] & (1 << (i & 7))) != 0;
+}
+
+
+/**
+ * Sets whether a cell is blocked.
+ */
+void GameField::blocked(int x, int y, bool blocked)
+{
+	const Chunk* _c = chunk(x, y);
+
+	if ((!_c || !_c->collision) && !blocked)
+		return;
+
+	Chunk& _w = allocateChunk(x, y);
+	if (!_w.collision)
+	{
+		_w.collision.reset(new unsigned char[COLLISION_BYTES]);
+		std::memset(_w.collision.get(), 0, COLLISION_BYTES);
+	}
+
+	touch(x, y);
+
+	int i = cellOffset(x, y);
+
+	if (blocked)
+		_w.collision[i >> 3] |= (1 << (i & 7));
+	else
+		_w.collision[i >> 3] &= ~(1 << (i & 7));
+}
+
+
+/**
+ * Gets the name of the map a cell links to. Returns an empty string
+ * if the cell isn't linked.
+ */
+const std::string& GameField::link(int x, int y) const
+{
+	static const std::string NO_LINK;
+
+	const LinkTable::Link* _l = mLinks.find(x, y);
+	if (!_l)
+		return NO_LINK;
+
+	return mLinks.name(_l->destination);
+}
+
+
+/**
+ * Gets the destination position of a linked cell.
+ */
+Point_2d GameField::linkDestination(int x, int y) const
+{
+	const LinkTable::Link* _l = mLinks.find(x, y);
+	if (!_l)
+		return Point_2d(0, 0);
+
+	return _l->position;
+}
+
+
+/**
+ * Links a cell to another map. An empty destination removes the link.
+ */
+void GameField::link(int x, int y, const std::string& destination, const Point_2d& pt)
+{
+	mLinks.set(x, y, destination, pt);
+	touch(x, y);
+}
+
+
+/**
+ * Gets the raw data of one layer of a chunk given by its index in row-major
+ * order. The data is CHUNK_AREA row-major entries or null if the layer holds
+ * nothing but default values.
+ */
+const GameField::TileIndex* GameField::chunkLayer(int chunk, Cell::TileLayer layer) const
+{
+	const Chunk* _c = mChunks[chunk].get();
+	return _c ? _c->layers[layer].get() : nullptr;
+}
+
+
+/**
+ * Replaces one layer of a chunk with CHUNK_AREA row-major entries.
+ * A null pointer resets the layer to default values.
+ */
+void GameField::chunkLayer(int chunk, Cell::TileLayer layer, const TileIndex* data)
+{
+	int x = (chunk % mChunksWide) << CHUNK_SHIFT;
+	int y = (chunk / mChunksWide) << CHUNK_SHIFT;
+
+	touch(x, y);
+
+	if (!data)
+	{
+		if (mChunks[chunk])
+			writableChunk(chunk).layers[layer].reset();
+		return;
+	}
+
+	Chunk& _c = allocateChunk(x, y);
+	TileIndex* layerData = _c.layers[layer] ? _c.layers[layer].get() : allocateLayer(_c, layer);
+	std::memcpy(layerData, data, CHUNK_AREA * sizeof(TileIndex));
+}
+
+
+/**
+ * Gets the packed collision flags of a chunk. The data is COLLISION_BYTES
+ * long or null if nothing in the chunk is blocked.
+ */
+const unsigned char* GameField::chunkCollision(int chunk) const
+{
+	const Chunk* _c = mChunks[chunk].get();
+	return _c ? _c->collision.get() : nullptr;
+}
+
+
+/**
+ * Replaces the packed collision flags of a chunk with COLLISION_BYTES
+ * bytes. A null pointer clears the collision flags.
+ */
+void GameField::chunkCollision(int chunk, const unsigned char* data)
 {
-	mField.resize(height);
+	int x = (chunk % mChunksWide) << CHUNK_SHIFT;
+	int y = (chunk / mChunksWide) << CHUNK_SHIFT;
 
-	for(size_t i = 0; i < mField.size(); i++)
-		mField[i].resize(width);
+	touch(x, y);
+
+	if (!data)
+	{
+		if (mChunks[chunk])
+			writableChunk(chunk).collision.reset();
+		return;
+	}
+
+	Chunk& _c = allocateChunk(x, y);
+	if (!_c.collision)
+		_c.collision.reset(new unsigned char[COLLISION_BYTES]);
+
+	std::memcpy(_c.collision.get(), data, COLLISION_BYTES);
 }
 
 
 /**
- * Returns the width of the game field.
+ * Resizes a game field.
+ * 
+ * Existing cells that are still within the new dimensions are kept, new
+ * cells get the default index of each layer. Links that fall outside the
+ * new dimensions are dropped.
  */
-int GameField::width() const
+void GameField::resize(int width, int height)
 {
-	return mField[0].size();
+	width = std::max(width, 0);
+	height = std::max(height, 0);
+
+	// Reset any cells that are about to fall outside of the field so
+	// that growing the field again later doesn't bring them back.
+	for (int y = 0; y < mHeight; y++)
+	{
+		for (int x = (y < height ? width : 0); x < mWidth; x++)
+		{
+			for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+				index(static_cast<Cell::TileLayer>(layer), x, y, defaultIndex(static_cast<Cell::TileLayer>(layer)));
+
+			blocked(x, y, false);
+		}
+	}
+
+	int chunksWide = (width + CHUNK_MASK) >> CHUNK_SHIFT;
+	int chunksHigh = (height + CHUNK_MASK) >> CHUNK_SHIFT;
+
+	ChunkTable chunks(chunksWide * chunksHigh);
+	for (int y = 0; y < std::min(chunksHigh, mChunksHigh); y++)
+	{
+		for (int x = 0; x < std::min(chunksWide, mChunksWide); x++)
+			chunks[y * chunksWide + x] = std::move(mChunks[y * mChunksWide + x]);
+	}
+	mChunks.swap(chunks);
+
+	// Chunks may have moved so every cached chunk is stale.
+	mRevisions.assign(mChunks.size(), ++mRevision);
+
+	mLinks.crop(width, height);
+
+	mWidth = width;
+	mHeight = height;
+	mChunksWide = chunksWide;
+	mChunksHigh = chunksHigh;
+
+	compact();
 }
 
 
 /**
- * Returns the height of the game field.
+ * Releases any layers, collision masks and chunks that have gone back
+ * to holding nothing but default values.
  */
-int GameField::height() const
+void GameField::compact()
 {
-	return mField.size();
+	for (size_t i = 0; i < mChunks.size(); i++)
+	{
+		const Chunk* _c = mChunks[i].get();
+		if (!_c)
+			continue;
+
+		// Bit per layer plus one for collision that holds nothing but default values.
+		unsigned int released = 0;
+
+		for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+		{
+			if (!_c->layers[layer])
+				continue;
+
+			TileIndex defaultValue = static_cast<TileIndex>(defaultIndex(static_cast<Cell::TileLayer>(layer)));
+			const TileIndex* begin = _c->layers[layer].get();
+			if (std::find_if(begin, begin + CHUNK_AREA, [defaultValue](TileIndex t) { return t != defaultValue; }) == begin + CHUNK_AREA)
+				released |= 1 << layer;
+		}
+
+		if (_c->collision)
+		{
+			const unsigned char* begin = _c->collision.get();
+			if (std::find_if(begin, begin + COLLISION_BYTES, [](unsigned char b) { return b != 0; }) == begin + COLLISION_BYTES)
+				released |= 1 << Cell::LAYER_COUNT;
+		}
+
+		if (released)
+		{
+			Chunk& _w = writableChunk(static_cast<int>(i));
+
+			for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+			{
+				if (released & (1 << layer))
+					_w.layers[layer].reset();
+			}
+
+			if (released & (1 << Cell::LAYER_COUNT))
+				_w.collision.reset();
+
+			_c = &_w;
+		}
+
+		if (_c->empty())
+			mChunks[i].reset();
+	}
 }
 
 
@@ -69,5 +465,75 @@ int GameField::height() const
  */
 bool GameField::empty() const
 {
-	return mField.empty();
-}
\ No newline at end of file
+	return mWidth == 0 || mHeight == 0;
+}
+
+
+/**
+ * Gets the approximate number of bytes of cell storage allocated by
+ * the GameField.
+ */
+size_t GameField::allocatedBytes() const
+{
+	size_t bytes = mChunks.size() * sizeof(ChunkTable::value_type);
+
+	for (size_t i = 0; i < mChunks.size(); i++)
+	{
+		const Chunk* _c = mChunks[i].get();
+		if (!_c)
+			continue;
+
+		bytes += sizeof(Chunk);
+
+		for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+			if (_c->layers[layer]) bytes += CHUNK_AREA * sizeof(TileIndex);
+
+		if (_c->collision)
+			bytes += COLLISION_BYTES;
+	}
+
+	return bytes;
+}
+
+
+/**
+ * Gets the chunk containing X, Y for writing, allocating it if necessary.
+ */
+GameField::Chunk& GameField::allocateChunk(int x, int y)
+{
+	std::shared_ptr<Chunk>& _c = mChunks[chunkOffset(x, y)];
+	if (!_c)
+		_c.reset(new Chunk());
+
+	return writableChunk(chunkOffset(x, y));
+}
+
+
+/**
+ * Gets an allocated chunk for writing. A chunk that's shared with a copy of
+ * the field is copied first so the copy doesn't see the write.
+ * 
+ * \note	The use count can't go up behind our back, only this field can
+ *			hand out new references to its chunks, so a chunk that isn't
+ *			shared here can't become shared while it's being written to.
+ */
+GameField::Chunk& GameField::writableChunk(int offset)
+{
+	std::shared_ptr<Chunk>& _c = mChunks[offset];
+	if (_c.use_count() > 1)
+		_c = std::make_shared<Chunk>(*_c);
+
+	return *_c;
+}
+
+
+/**
+ * Allocates a layer within a chunk and fills it with the layer's default value.
+ */
+GameField::TileIndex* GameField::allocateLayer(Chunk& chunk, Cell::TileLayer layer)
+{
+	chunk.layers[layer].reset(new TileIndex[CHUNK_AREA]);
+	std::fill(chunk.layers[layer].get(), chunk.layers[layer].get() + CHUNK_AREA, static_cast<TileIndex>(defaultIndex(layer)));
+
+	return chunk.layers[layer].get();
+}
@@ -1,37 +1,161 @@
 #ifndef __GAME_FIELD__
 #define __GAME_FIELD__
 
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "Cell.h"
+#include "LinkTable.h"
 
 
 /**
  * \class GameField
- * \brief 
+ * \brief Stores the tile, collision and link data of a Map.
  * 
+ * The field is split into square chunks of CHUNK_SIZE x CHUNK_SIZE cells.
+ * Chunks that have never been written to with anything other than default
+ * values aren't allocated at all and within a chunk each tile layer and the
+ * collision mask are only allocated on their first non-default write. Memory
+ * use scales with painted content instead of with map area.
  * 
+ * Within a chunk each tile layer is a contiguous, row-major array of 16-bit
+ * tile indices and collision is a packed bit array. Links, of which there are
+ * only ever a handful, are kept in a separate LinkTable.
+ * 
+ * Code that walks large portions of the field should use span() to get at
+ * the raw layer data one chunk row at a time instead of going through Cell
+ * handles. Spans of unallocated layers point at a shared row of default
+ * values so readers never need to special case them.
+ * 
+ * Every write bumps a revision counter for the chunk it lands in so that
+ * anything caching data derived from a chunk can tell when it's stale.
+ * 
+ * Chunks are shared between copies of a GameField and only copied when one
+ * of the copies writes to them so copying a field is cheap. A copy can be
+ * read on another thread while the original keeps being edited.
  */
 class GameField
 {
+public:
+
+	typedef short TileIndex;
+
+	static const int CHUNK_SHIFT = 5;
+	static const int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+	static const int CHUNK_MASK = CHUNK_SIZE - 1;
+	static const int CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+	static const int COLLISION_BYTES = CHUNK_AREA / 8;
+
 public:
 
 	GameField();
 	GameField(int width, int height);
+	GameField(const GameField& field);
+	GameField(GameField&& field) = default;
+
+	GameField& operator=(const GameField& field);
+	GameField& operator=(GameField&& field) = default;
+
+	Cell cell(int x, int y);
+
+	int index(Cell::TileLayer layer, int x, int y) const;
+	void index(Cell::TileLayer layer, int x, int y, int index);
+
+	const TileIndex* span(Cell::TileLayer layer, int x, int y) const;
+	TileIndex* writableSpan(Cell::TileLayer layer, int x, int y);
+
+	/**
+	 * Gets the number of cells from X to the end of its chunk row. This is
+	 * the number of entries that can be read from a span starting at X.
+	 */
+	static int spanLength(int x) { return CHUNK_SIZE - (x & CHUNK_MASK); }
+
+	bool blocked(int x, int y) const;
+	void blocked(int x, int y, bool blocked);
+
+	const std::string& link(int x, int y) const;
+	Point_2d linkDestination(int x, int y) const;
+	void link(int x, int y, const std::string& destination, const Point_2d& pt);
+
+	const LinkTable& links() const { return mLinks; }
+
+	int chunksWide() const { return mChunksWide; }
+	int chunksHigh() const { return mChunksHigh; }
+
+	/**
+	 * Gets the revision of a chunk given in chunk coordinates. The revision
+	 * changes whenever anything within the chunk is written to.
+	 */
+	unsigned int revision(int chunkX, int chunkY) const { return mRevisions[chunkY * mChunksWide + chunkX]; }
 
-	Cell& cell(int x, int y);
+	/**
+	 * Gets the revision of the whole field. Changes whenever anything in the
+	 * field is written to.
+	 */
+	unsigned int revision() const { return mRevision; }
+
+	const TileIndex* chunkLayer(int chunk, Cell::TileLayer layer) const;
+	void chunkLayer(int chunk, Cell::TileLayer layer, const TileIndex* data);
+
+	const unsigned char* chunkCollision(int chunk) const;
+	void chunkCollision(int chunk, const unsigned char* data);
 
 	void resize(int width, int height);
 
-	int width() const;
-	int height() const;
+	void compact();
+
+	int width() const { return mWidth; }
+	int height() const { return mHeight; }
 
 	bool empty() const;
 
+	size_t allocatedBytes() const;
+
+	static int defaultIndex(Cell::TileLayer layer) { return layer == Cell::LAYER_BASE ? 0 : Cell::EMPTY_INDEX; }
+
 private:
 
-	std::vector<std::vector<Cell> >		mField;
+	/**
+	 * Block of CHUNK_SIZE x CHUNK_SIZE cells. Any layer or collision
+	 * mask that is null holds nothing but default values.
+	 */
+	struct Chunk
+	{
+		Chunk() {}
+		Chunk(const Chunk& chunk);
+
+		bool empty() const;
+
+		std::unique_ptr<TileIndex[]>		layers[Cell::LAYER_COUNT];	/**< Tile indices, one row-major array per layer. */
+		std::unique_ptr<unsigned char[]>	collision;					/**< Collision flags packed eight cells to a byte. */
+	};
+
+	typedef std::vector<std::shared_ptr<Chunk> > ChunkTable;
+
+	int chunkOffset(int x, int y) const { return (y >> CHUNK_SHIFT) * mChunksWide + (x >> CHUNK_SHIFT); }
+	static int cellOffset(int x, int y) { return ((y & CHUNK_MASK) << CHUNK_SHIFT) + (x & CHUNK_MASK); }
+
+	const Chunk* chunk(int x, int y) const { return mChunks[chunkOffset(x, y)].get(); }
+	Chunk& allocateChunk(int x, int y);
+	Chunk& writableChunk(int offset);
+
+	static TileIndex* allocateLayer(Chunk& chunk, Cell::TileLayer layer);
+
+	void touch(int x, int y) { mRevisions[chunkOffset(x, y)] = ++mRevision; }
+
+	int					mWidth;
+	int					mHeight;
+
+	int					mChunksWide;
+	int					mChunksHigh;
+
+	ChunkTable			mChunks;		/**< Chunks in row-major order. Null entries are entirely default. Shared with copies until written to. */
+	LinkTable			mLinks;			/**< Linked cells. */
+
+	std::vector<unsigned int>	mRevisions;		/**< Revision of each chunk in row-major order. */
+	unsigned int		mRevision;		/**< Most recently handed out revision. */
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,376 @@
+#include "LevelEncoding.h"
+
+#include "../XmlWriter.h"
+
+#include "zlib.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+using namespace std;
+
+const char* ENCODING_NAMES[] = { "TEXT", "CSV", "RLE", "BASE64_ZLIB" };
+
+const char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+const size_t DEFLATE_BUFFER_SIZE = 4096;		/**< Size of the buffer deflate output passes through on its way to base64. */
+
+
+/**
+ * Gets the value of a base64 character or -1 if it isn't one.
+ */
+static int base64Value(char c)
+{
+	if (c >= 'A' && c <= 'Z') return c - 'A';
+	if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+	if (c >= '0' && c <= '9') return c - '0' + 52;
+	if (c == '+') return 62;
+	if (c == '/') return 63;
+
+	return -1;
+}
+
+
+/**
+ * Reads a decimal integer, advancing the read position past it. Fails on
+ * values that don't fit in an int.
+ */
+static bool readInt(const char*& _p, const char* end, int& value)
+{
+	bool negative = false;
+	if (_p < end && (*_p == '-' || *_p == '+'))
+		negative = *_p++ == '-';
+
+	if (_p >= end || *_p < '0' || *_p > '9')
+		return false;
+
+	long long magnitude = 0;
+	while (_p < end && *_p >= '0' && *_p <= '9')
+	{
+		magnitude = magnitude * 10 + (*_p++ - '0');
+		if (magnitude > INT_MAX)
+			return false;
+	}
+
+	value = static_cast<int>(negative ? -magnitude : magnitude);
+
+	return true;
+}
+
+
+static void appendInt(string& text, int value)
+{
+	char buffer[XmlWriter::INT_LENGTH];
+	text.append(XmlWriter::formatInt(value, buffer + sizeof(buffer)), buffer + sizeof(buffer));
+}
+
+
+/**
+ * Decodes CSV and RLE text. CSV is RLE without any runs so both
+ * are read the same way.
+ */
+static bool decodeText(const char* text, size_t length, vector<GameField::TileIndex>& values)
+{
+	const char* _p = text;
+	const char* end = text + length;
+
+	size_t count = 0;
+	while (_p < end)
+	{
+		if (*_p == ',' || *_p == ' ' || *_p == '\t' || *_p == '\r' || *_p == '\n')
+		{
+			++_p;
+			continue;
+		}
+
+		int run = 1, value = 0;
+		if (!readInt(_p, end, value))
+			return false;
+
+		if (_p < end && *_p == '*')
+		{
+			++_p;
+			run = value;
+			if (run < 0 || !readInt(_p, end, value))
+				return false;
+		}
+
+		if (count + run > values.size())
+			return false;
+
+		std::fill(values.begin() + count, values.begin() + count + run, static_cast<GameField::TileIndex>(value));
+		count += run;
+	}
+
+	return count == values.size();
+}
+
+
+static bool decodeBase64Zlib(const char* text, size_t length, vector<GameField::TileIndex>& values)
+{
+	if (values.empty())
+		return true;
+
+	vector<unsigned char> compressed;
+	compressed.reserve(length * 3 / 4);
+
+	unsigned int bits = 0;
+	int bitCount = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		int value = base64Value(text[i]);
+		if (value < 0)
+			continue;
+
+		bits = (bits << 6) | value;
+		bitCount += 6;
+
+		if (bitCount >= 8)
+		{
+			bitCount -= 8;
+			compressed.push_back(static_cast<unsigned char>(bits >> bitCount));
+		}
+	}
+
+	vector<unsigned char> packed(values.size() * 2);
+	uLongf size = static_cast<uLongf>(packed.size());
+	if (compressed.empty() || uncompress(packed.data(), &size, compressed.data(), static_cast<uLong>(compressed.size())) != Z_OK || size != packed.size())
+		return false;
+
+	for (size_t i = 0; i < values.size(); i++)
+		values[i] = static_cast<GameField::TileIndex>(packed[i * 2] | (packed[i * 2 + 1] << 8));
+
+	return true;
+}
+
+
+/**
+ * Appends a row of values as CSV, or RLE if RUNS is set.
+ */
+static void encodeText(const GameField::TileIndex* values, int width, bool runs, string& text)
+{
+	text += '\n';
+
+	for (int i = 0; i < width; )
+	{
+		int run = 1;
+		if (runs)
+		{
+			while (i + run < width && values[i + run] == values[i])
+				run++;
+		}
+
+		if (i != 0)
+			text += ',';
+
+		if (run > 1)
+		{
+			appendInt(text, run);
+			text += '*';
+		}
+
+		appendInt(text, values[i]);
+		i += run;
+	}
+}
+
+
+/**
+ * Gets an encoding by its name as used in the 'encoding' attribute.
+ */
+LevelEncoding levelEncoding(const char* name, size_t length)
+{
+	for (int i = 0; i < ENCODING_UNKNOWN; i++)
+	{
+		if (strlen(ENCODING_NAMES[i]) == length && memcmp(ENCODING_NAMES[i], name, length) == 0)
+			return static_cast<LevelEncoding>(i);
+	}
+
+	return ENCODING_UNKNOWN;
+}
+
+
+/**
+ * Gets the name of an encoding as used in the 'encoding' attribute.
+ */
+const char* levelEncodingName(LevelEncoding encoding)
+{
+	return encoding < ENCODING_UNKNOWN ? ENCODING_NAMES[encoding] : "";
+}
+
+
+/**
+ * Decodes the contents of a <layer> element.
+ * 
+ * \param	values	Receives the decoded values. Must already be sized to the
+ *					number of cells in the layer.
+ * 
+ * \return	False if the text is malformed or doesn't hold exactly as many
+ *			values as expected.
+ */
+bool decodeLayer(LevelEncoding encoding, const char* text, size_t length, vector<GameField::TileIndex>& values)
+{
+	switch (encoding)
+	{
+		case ENCODING_CSV:
+		case ENCODING_RLE:
+			return decodeText(text, length, values);
+
+		case ENCODING_BASE64_ZLIB:
+			return decodeBase64Zlib(text, length, values);
+
+		default:
+			return false;
+	}
+}
+
+
+/**
+ * C'tor
+ * 
+ * \param	text	String encoded text is appended to.
+ */
+LayerEncoder::LayerEncoder(LevelEncoding encoding, std::string& text):	mEncoding(encoding),
+																		mText(text),
+																		mPending(0),
+																		mFailed(false)
+{
+	if (mEncoding != ENCODING_BASE64_ZLIB)
+		return;
+
+	mStream.reset(new z_stream());
+	mCompressed.resize(DEFLATE_BUFFER_SIZE);
+
+	if (deflateInit(mStream.get(), Z_DEFAULT_COMPRESSION) != Z_OK)
+	{
+		mStream.reset();
+		mFailed = true;
+	}
+}
+
+
+/**
+ * D'tor
+ */
+LayerEncoder::~LayerEncoder()
+{
+	if (mStream)
+		deflateEnd(mStream.get());
+}
+
+
+/**
+ * Encodes the next row of values.
+ * 
+ * \return	False if the values couldn't be encoded. The layer is incomplete.
+ */
+bool LayerEncoder::row(const GameField::TileIndex* values, int width)
+{
+	if (mFailed)
+		return false;
+
+	switch (mEncoding)
+	{
+		case ENCODING_CSV:
+			encodeText(values, width, false, mText);
+			return true;
+
+		case ENCODING_RLE:
+			encodeText(values, width, true, mText);
+			return true;
+
+		case ENCODING_BASE64_ZLIB:
+			mPacked.resize(width * 2);
+			for (int i = 0; i < width; i++)
+			{
+				mPacked[i * 2] = static_cast<unsigned char>(values[i] & 0xff);
+				mPacked[i * 2 + 1] = static_cast<unsigned char>((values[i] >> 8) & 0xff);
+			}
+
+			mFailed = !deflateInput(mPacked.data(), mPacked.size(), false);
+			return !mFailed;
+
+		default:
+			mFailed = true;
+			return false;
+	}
+}
+
+
+/**
+ * Encodes whatever is still buffered after the last row.
+ * 
+ * \return	False if the layer couldn't be encoded.
+ */
+bool LayerEncoder::finish()
+{
+	if (mFailed || mEncoding == ENCODING_TEXT || mEncoding == ENCODING_UNKNOWN)
+		return false;
+
+	if (mEncoding == ENCODING_BASE64_ZLIB)
+	{
+		mFailed = !deflateInput(nullptr, 0, true);
+		if (!mFailed)
+			appendBase64(true);
+
+		return !mFailed;
+	}
+
+	mText += '\n';
+	return true;
+}
+
+
+/**
+ * Feeds data to deflate, base64 encoding its output as the buffer fills.
+ */
+bool LayerEncoder::deflateInput(const unsigned char* data, size_t size, bool finish)
+{
+	mStream->next_in = const_cast<Bytef*>(data);
+	mStream->avail_in = static_cast<uInt>(size);
+
+	for (;;)
+	{
+		mStream->next_out = mCompressed.data() + mPending;
+		mStream->avail_out = static_cast<uInt>(mCompressed.size() - mPending);
+
+		int result = deflate(mStream.get(), finish ? Z_FINISH : Z_NO_FLUSH);
+		if (result == Z_STREAM_ERROR)
+			return false;
+
+		bool full = mStream->avail_out == 0;
+		mPending = mCompressed.size() - mStream->avail_out;
+		appendBase64(false);
+
+		// Without Z_FINISH deflate only stops short of the end of the input
+		// when it runs out of room for output.
+		if (finish ? result == Z_STREAM_END : !full)
+			return true;
+	}
+}
+
+
+/**
+ * Base64 encodes the pending deflate output. Unless it's the final output
+ * the bytes that don't make up a whole group of three are kept for later.
+ */
+void LayerEncoder::appendBase64(bool final)
+{
+	size_t size = final ? mPending : mPending - mPending % 3;
+
+	for (size_t i = 0; i < size; i += 3)
+	{
+		unsigned int bits = mCompressed[i] << 16;
+		if (i + 1 < size) bits |= mCompressed[i + 1] << 8;
+		if (i + 2 < size) bits |= mCompressed[i + 2];
+
+		mText += BASE64_CHARS[(bits >> 18) & 63];
+		mText += BASE64_CHARS[(bits >> 12) & 63];
+		mText += i + 1 < size ? BASE64_CHARS[(bits >> 6) & 63] : '=';
+		mText += i + 2 < size ? BASE64_CHARS[bits & 63] : '=';
+	}
+
+	std::copy(mCompressed.begin() + size, mCompressed.begin() + mPending, mCompressed.begin());
+	mPending -= size;
+}
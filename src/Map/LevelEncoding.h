@@ -0,0 +1,79 @@
+#ifndef __LEVEL_ENCODING__
+#define __LEVEL_ENCODING__
+
+#include "GameField.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct z_stream_s;
+
+/**
+ * Ways the cells of a <level> element can be stored in a map file.
+ * 
+ * With everything but ENCODING_TEXT, a level holds one <layer> element per
+ * tile layer plus one for collision, each holding every value of that layer
+ * in row-major order:
+ * 
+ *	ENCODING_TEXT			One <cell> element per cell. The original format.
+ *	ENCODING_CSV			Comma separated decimal values, one line per row.
+ *	ENCODING_RLE			Like CSV but a run of equal values may be written
+ *							as count*value. Runs never cross rows.
+ *	ENCODING_BASE64_ZLIB	Base64 of the zlib compressed values packed as
+ *							16-bit little-endian integers.
+ */
+enum LevelEncoding
+{
+	ENCODING_TEXT,
+	ENCODING_CSV,
+	ENCODING_RLE,
+	ENCODING_BASE64_ZLIB,
+	ENCODING_UNKNOWN
+};
+
+LevelEncoding levelEncoding(const char* name, size_t length);
+const char* levelEncodingName(LevelEncoding encoding);
+
+bool decodeLayer(LevelEncoding encoding, const char* text, size_t length, std::vector<GameField::TileIndex>& values);
+
+
+/**
+ * \class LayerEncoder
+ * \brief Encodes the values of a layer one row at a time.
+ * 
+ * Encoded text is appended to a string that the caller is expected to
+ * drain after every row, so encoding a layer takes about a row's worth of
+ * memory no matter how large the map is. CSV and RLE runs never cross rows
+ * and zlib is streamed through a fixed size buffer.
+ */
+class LayerEncoder
+{
+public:
+
+	LayerEncoder(LevelEncoding encoding, std::string& text);
+	~LayerEncoder();
+
+	bool row(const GameField::TileIndex* values, int width);
+	bool finish();
+
+private:
+
+	LayerEncoder(const LayerEncoder&);				// Explicitly disallowed
+	LayerEncoder& operator=(const LayerEncoder&);	// Explicitly disallowed
+
+	bool deflateInput(const unsigned char* data, size_t size, bool finish);
+	void appendBase64(bool final);
+
+	LevelEncoding					mEncoding;
+	std::string&					mText;			/**< Encoded text not yet taken by the caller. */
+
+	std::unique_ptr<z_stream_s>		mStream;		/**< Deflate state for ENCODING_BASE64_ZLIB. */
+	std::vector<unsigned char>		mPacked;		/**< Current row as 16-bit little-endian values. */
+	std::vector<unsigned char>		mCompressed;	/**< Deflate output, only the tail that doesn't make a whole base64 group is kept. */
+	size_t							mPending;		/**< Number of bytes in mCompressed. */
+	bool							mFailed;
+};
+
+
+#endif
@@ -0,0 +1,95 @@
+#include "LinkTable.h"
+
+#include <algorithm>
+
+
+/**
+ * Finds the link of a given cell.
+ * 
+ * \return	Pointer to the Link or nullptr if the cell isn't linked.
+ */
+const LinkTable::Link* LinkTable::find(int x, int y) const
+{
+	Table::const_iterator it = mLinks.find(key(x, y));
+	if (it == mLinks.end())
+		return nullptr;
+
+	return &it->second;
+}
+
+
+/**
+ * Links a cell to another map. An empty destination removes the link.
+ */
+void LinkTable::set(int x, int y, const std::string& destination, const Point_2d& pt)
+{
+	if (destination.empty())
+	{
+		erase(x, y);
+		return;
+	}
+
+	Link& _l = mLinks[key(x, y)];
+	_l.x = x;
+	_l.y = y;
+	_l.destination = intern(destination);
+	_l.position = pt;
+}
+
+
+/**
+ * Removes the link of a given cell, if any.
+ */
+void LinkTable::erase(int x, int y)
+{
+	mLinks.erase(key(x, y));
+}
+
+
+/**
+ * Drops any links that fall outside of the given dimensions.
+ */
+void LinkTable::crop(int width, int height)
+{
+	for (Table::iterator it = mLinks.begin(); it != mLinks.end(); )
+	{
+		if (it->second.x >= width || it->second.y >= height)
+			it = mLinks.erase(it);
+		else
+			++it;
+	}
+}
+
+
+/**
+ * Gets all links ordered by row and then column. Used where a stable
+ * order matters, e.g., when writing links to a file.
+ */
+std::vector<const LinkTable::Link*> LinkTable::sorted() const
+{
+	std::vector<const Link*> links;
+	links.reserve(mLinks.size());
+
+	for (const_iterator it = mLinks.begin(); it != mLinks.end(); ++it)
+		links.push_back(&it->second);
+
+	std::sort(links.begin(), links.end(), [](const Link* a, const Link* b) { return a->y != b->y ? a->y < b->y : a->x < b->x; });
+
+	return links;
+}
+
+
+/**
+ * Gets the interned id of a destination map name, adding it if necessary.
+ */
+int LinkTable::intern(const std::string& name)
+{
+	std::unordered_map<std::string, int>::iterator it = mNameIds.find(name);
+	if (it != mNameIds.end())
+		return it->second;
+
+	mNames.push_back(name);
+	mNameIds[name] = static_cast<int>(mNames.size() - 1);
+
+	return static_cast<int>(mNames.size() - 1);
+}
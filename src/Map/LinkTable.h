@@ -0,0 +1,74 @@
+#ifndef __LINK_TABLE__
+#define __LINK_TABLE__
+
+#include "NAS2D/NAS2D.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace NAS2D;
+
+/**
+ * \class LinkTable
+ * \brief Sparse table of cells that link to other maps.
+ * 
+ * Only a handful of cells on any map are links so they're kept in a hash
+ * table keyed by cell coordinate instead of in every cell. Destination map
+ * names are interned so that many links to the same map share one string.
+ * 
+ * Iterating the table visits only linked cells, in no particular order.
+ */
+class LinkTable
+{
+public:
+
+	/**
+	 * A single linked cell.
+	 */
+	struct Link
+	{
+		int			x;				/**< X-Coordinate of the linked cell. */
+		int			y;				/**< Y-Coordinate of the linked cell. */
+		int			destination;	/**< Interned name of the map to link to. See name(). */
+		Point_2d	position;		/**< Position within the destination map. */
+	};
+
+	typedef std::unordered_map<unsigned long long, Link> Table;
+	typedef Table::const_iterator const_iterator;
+
+public:
+
+	LinkTable() {}
+
+	const Link* find(int x, int y) const;
+
+	void set(int x, int y, const std::string& destination, const Point_2d& pt);
+	void erase(int x, int y);
+
+	void crop(int width, int height);
+
+	const std::string& name(int id) const { return mNames[id]; }
+
+	const_iterator begin() const { return mLinks.begin(); }
+	const_iterator end() const { return mLinks.end(); }
+
+	size_t size() const { return mLinks.size(); }
+	bool empty() const { return mLinks.empty(); }
+
+	std::vector<const Link*> sorted() const;
+
+private:
+
+	static unsigned long long key(int x, int y) { return (static_cast<unsigned long long>(static_cast<unsigned int>(y)) << 32) | static_cast<unsigned int>(x); }
+
+	int intern(const std::string& name);
+
+	Table									mLinks;			/**< Linked cells keyed by packed cell coordinate. */
+
+	std::vector<std::string>				mNames;			/**< Interned destination map names. */
+	std::unordered_map<std::string, int>	mNameIds;		/**< Lookup from destination map name to interned id. */
+};
+
+
+#endif
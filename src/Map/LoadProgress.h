@@ -0,0 +1,53 @@
+#ifndef __LOAD_PROGRESS__
+#define __LOAD_PROGRESS__
+
+#include <atomic>
+
+/**
+ * \class LoadProgress
+ * \brief Progress and cancellation of a Map being loaded on another thread.
+ * 
+ * The loading thread reports which stage it's in and how far along that
+ * stage is, any other thread may read them at any time and ask for the
+ * load to be cancelled. Loading code checks cancelled() every so often and
+ * stops early, leaving a partially loaded Map that should be discarded.
+ */
+class LoadProgress
+{
+public:
+
+	enum Stage
+	{
+		STAGE_READING,			/**< Reading and parsing the map file. */
+		STAGE_TILESET,			/**< Decoding and analyzing the tileset. */
+		STAGE_DONE
+	};
+
+public:
+
+	LoadProgress(): mStage(STAGE_READING), mProgress(0.0f), mCancelled(false) {}
+
+	Stage stage() const { return mStage; }
+	void stage(Stage stage) { mStage = stage; mProgress = 0.0f; }
+
+	/**
+	 * Progress of the current stage from 0.0 to 1.0.
+	 */
+	float progress() const { return mProgress; }
+	void progress(float progress) { mProgress = progress; }
+
+	void cancel() { mCancelled = true; }
+	bool cancelled() const { return mCancelled; }
+
+private:
+
+	LoadProgress(const LoadProgress&);				// Explicitly disallowed
+	LoadProgress& operator=(const LoadProgress&);	// Explicitly disallowed
+
+	std::atomic<Stage>	mStage;
+	std::atomic<float>	mProgress;
+	std::atomic<bool>	mCancelled;
+};
+
+
+#endif
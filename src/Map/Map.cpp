@@ -1,8 +1,18 @@
 #include "Map.h"
 
 #include "../Common.h"
+#include "../FrameProfiler.h"
+#include "../OpenGL.h"
+#include "../TraceRecorder.h"
+#include "../XmlPullReader.h"
+#include "../XmlWriter.h"
 
+#include "LevelEncoding.h"
+
+#include <algorithm>
+#include <cctype>
 #include <cmath>
+#include <cstring>
 #include <sstream>
 
 using namespace std;
@@ -13,23 +23,38 @@ const std::string	MAP_DRIVER_VERSION	= "0.30";
 
 const int			EDGE_MARGIN			= 10;
 
+/**
+ * Names of the <layer> elements of encoded levels. Indexed by Cell::TileLayer
+ * with collision last.
+ */
+const char*			LAYER_NAMES[]		= { "base", "base_detail", "detail", "foreground", "collision" };
+
+const unsigned int	BATCH_LIFETIME		= 300;		/**< Frames a chunk batch is kept after it was last drawn. */
+
 
 /**
  * C'tor
  */
-Map::Map(const string& mapPath):	mField(0, 0),
-									mViewport(0, 0, static_cast<int>(Utility<Renderer>::get().width()), static_cast<int>(Utility<Renderer>::get().height())),
-									mCameraFocus(nullptr),
-									mDrawBg(true),
-									mDrawBgDetail(true),
-									mDrawDetail(true),
-									mDrawForeground(true),
-									mDrawCollision(false),
-									mShowLinks(false),
-									mShowTitlePlaque(false),
-									mEdgeExit(false)
+Map::Map(const string& mapPath, LoadProgress* progress):	mField(0, 0),
+															mCameraFocus(nullptr),
+															mFrame(0),
+															mLevelEncoding(ENCODING_TEXT),
+															mProgress(progress),
+															mDrawBg(true),
+															mDrawBgDetail(true),
+															mDrawDetail(true),
+															mDrawForeground(true),
+															mDrawCollision(false),
+															mShowLinks(false),
+															mShowTitlePlaque(false),
+															mEdgeExit(false)
 {
 	load(mapPath);
+
+	if(mProgress)
+		mProgress->stage(LoadProgress::STAGE_DONE);
+
+	mProgress = nullptr;
 }
 
 
@@ -39,9 +64,11 @@ Map::Map(const string& mapPath):	mField(0, 0),
 Map::Map(const string& name, const string& tsetPath, int width, int height):	mName(name),
 																				mField(width, height),
 																				mTileset(tsetPath, CELL_DIMENSIONS.w(), CELL_DIMENSIONS.h()),
-																				mViewport(0, 0, static_cast<int>(Utility<Renderer>::get().width()), static_cast<int>(Utility<Renderer>::get().height())),
-																				mCameraSpace(0, 0, mField.width() * mTileset.width() - mViewport.w(), mField.height() * mTileset.height() - mViewport.h()),
+																				mCameraSpace(0, 0, mField.width() * mTileset.width(), mField.height() * mTileset.height()),
 																				mCameraFocus(nullptr),
+																				mFrame(0),
+																				mLevelEncoding(ENCODING_TEXT),
+																				mProgress(nullptr),
 																				mDrawBg(true),
 																				mDrawBgDetail(true),
 																				mDrawDetail(true),
@@ -53,6 +80,12 @@ Map::Map(const string& name, const string& tsetPath, int width, int height):	mNa
 {}
 
 
+/**
+ * Move c'tor
+ */
+Map::Map(Map&& map) = default;
+
+
 /**
  * D'tor
  */
@@ -128,36 +161,42 @@ int Map::gridLocation(int point, int cameraPoint, int tileDimension, int viewpor
 void Map::drawCollision(bool draw)
 {
 	mDrawCollision = draw;
+	invalidateBatches();
 }
 
 
 void Map::showLinks(bool show)
 {
 	mShowLinks = show;
+	invalidateBatches();
 }
 
 
 void Map::drawBg(bool draw)
 {
 	mDrawBg = draw;
+	invalidateBatches();
 }
 
 
 void Map::drawBgDetail(bool draw)
 {
 	mDrawBgDetail = draw;
+	invalidateBatches();
 }
 
 
 void Map::drawDetail(bool draw)
 {
 	mDrawDetail = draw;
+	invalidateBatches();
 }
 
 
 void Map::drawForeground(bool draw)
 {
 	mDrawForeground = draw;
+	invalidateBatches();
 }
 
 
@@ -311,70 +350,208 @@ void Map::update()
 {
 	updateCamera();
 
+	mFrame++;
+
 	Renderer& r = Utility<Renderer>::get();
 
-	int offsetX = mViewport.x() + static_cast<int>(mCameraPosition.x()) % CELL_DIMENSIONS.w();
-	int offsetY = mViewport.y() + static_cast<int>(mCameraPosition.y()) % CELL_DIMENSIONS.h();
+	int cameraX = static_cast<int>(mCameraPosition.x());
+	int cameraY = static_cast<int>(mCameraPosition.y());
 
-	static Point_2d tileUpperLeft;
-	static Point_2d tileLowerRight;
+	// Cells are always CELL_DIMENSIONS in size, even without a tileset to draw them.
+	int chunkWidth = GameField::CHUNK_SIZE * CELL_DIMENSIONS.w();
+	int chunkHeight = GameField::CHUNK_SIZE * CELL_DIMENSIONS.h();
 
-	tileUpperLeft.x(gridLocation(static_cast<int>(mCameraPosition.x()), 0, CELL_DIMENSIONS.w(), mViewport.w()));
-	tileUpperLeft.y(gridLocation(static_cast<int>(mCameraPosition.y()), 0, CELL_DIMENSIONS.h(), mViewport.h()));
+	int firstChunkX = std::max(cameraX / chunkWidth, 0);
+	int firstChunkY = std::max(cameraY / chunkHeight, 0);
+	int lastChunkX = std::min((cameraX + mViewport.w()) / chunkWidth, mField.chunksWide() - 1);
+	int lastChunkY = std::min((cameraY + mViewport.h()) / chunkHeight, mField.chunksHigh() - 1);
 
-	tileLowerRight.x(gridLocation(static_cast<int>(mCameraPosition.x()) + mViewport.w(), 0, CELL_DIMENSIONS.w(), mViewport.w()));
-	tileLowerRight.y(gridLocation(static_cast<int>(mCameraPosition.y()) + mViewport.h(), 0, CELL_DIMENSIONS.h(), mViewport.h()));
+	// Chunks are drawn whole so anything hanging over the edges of the viewport is clipped.
+	glScissor(mViewport.x(), static_cast<int>(r.height()) - mViewport.y() - mViewport.h(), mViewport.w(), mViewport.h());
 
-	// The '&& x < dimension()' is a bit hackish... would like to clean this up.
-	for(int row = tileUpperLeft.y(); row <= tileLowerRight.y() && row < height(); row++)
 	{
-		for(int col = tileUpperLeft.x(); col <= tileLowerRight.x() && col < width(); col++)
+		ScopedTimer timer(STAGE_MAP_BELOW);
+
+		glEnable(GL_SCISSOR_TEST);
+		for(int chunkY = firstChunkY; chunkY <= lastChunkY; chunkY++)
 		{
-			Cell cell = mField.cell(col, row);
-			
-			int rasterX = mViewport.x() + ((col - tileUpperLeft.x()) * mTileset.width()) - offsetX + mViewport.x();
-			int rasterY = mViewport.y() + ((row - tileUpperLeft.y()) * mTileset.height()) - offsetY + mViewport.y();
+			for(int chunkX = firstChunkX; chunkX <= lastChunkX; chunkX++)
+				chunkBatch(chunkX, chunkY).below.drawTiles(mTileset, static_cast<float>(mViewport.x() + chunkX * chunkWidth - cameraX), static_cast<float>(mViewport.y() + chunkY * chunkHeight - cameraY));
+		}
+		glDisable(GL_SCISSOR_TEST);
+	}
 
-			if (mDrawBg && cell.index(Cell::LAYER_BASE) >= 0)
-				mTileset.drawTile(cell.index(Cell::LAYER_BASE), rasterX, rasterY);
+	{
+		ScopedTimer timer(STAGE_ENTITIES);
 
-			if(mDrawBgDetail && cell.index(Cell::LAYER_BASE_DETAIL) >= 0)
-				mTileset.drawTile(cell.index(Cell::LAYER_BASE_DETAIL), rasterX, rasterY);
+		for(size_t i = 0; i < mEntityList.size(); i++)
+		{
+			Entity* e = mEntityList[i];
+			e->update();
+			e->draw(static_cast<int>(e->position().x() - mCameraPosition.x()), static_cast<int>(e->position().y() - mCameraPosition.y()));
+		}
+	}
 
-			if(mDrawDetail && cell.index(Cell::LAYER_DETAIL) >= 0)
-				mTileset.drawTile(cell.index(Cell::LAYER_DETAIL), rasterX, rasterY);
+	{
+		ScopedTimer timer(STAGE_MAP_ABOVE);
 
+		glEnable(GL_SCISSOR_TEST);
+		for(int chunkY = firstChunkY; chunkY <= lastChunkY; chunkY++)
+		{
+			for(int chunkX = firstChunkX; chunkX <= lastChunkX; chunkX++)
+			{
+				const ChunkBatch& batch = chunkBatch(chunkX, chunkY);
+				float x = static_cast<float>(mViewport.x() + chunkX * chunkWidth - cameraX);
+				float y = static_cast<float>(mViewport.y() + chunkY * chunkHeight - cameraY);
+
+				batch.above.drawTiles(mTileset, x, y);
+				batch.above.drawOverlays(x, y);
+			}
 		}
+		glDisable(GL_SCISSOR_TEST);
 	}
 
-	for(size_t i = 0; i < mEntityList.size(); i++)
+	trimBatches();
+	mTileset.trimPages();
+}
+
+
+/**
+ * Gets the batch of a chunk, rebuilding it if the chunk has changed
+ * since the batch was last built.
+ */
+Map::ChunkBatch& Map::chunkBatch(int chunkX, int chunkY)
+{
+	ChunkBatch& batch = mChunkBatches[(chunkY << 16) | chunkX];
+
+	unsigned int revision = mField.revision(chunkX, chunkY);
+	if(!batch.built || batch.revision != revision)
 	{
-		Entity* e = mEntityList[i];
-		e->update();
-		e->draw(static_cast<int>(e->position().x() - mCameraPosition.x()), static_cast<int>(e->position().y() - mCameraPosition.y()));
+		buildChunkBatch(batch, chunkX, chunkY);
+		batch.revision = revision;
+		batch.built = true;
 	}
 
-	for(int row = tileUpperLeft.y(); row <= tileLowerRight.y() && row < height(); row++)
+	batch.lastFrame = mFrame;
+	return batch;
+}
+
+
+/**
+ * Builds the geometry of a chunk from the GameField honoring
+ * the current layer visibility flags.
+ */
+void Map::buildChunkBatch(ChunkBatch& batch, int chunkX, int chunkY)
+{
+	batch.below.clear();
+	batch.above.clear();
+
+	const int tileWidth = CELL_DIMENSIONS.w();
+	const int tileHeight = CELL_DIMENSIONS.h();
+
+	const bool draw[Cell::LAYER_COUNT] = { mDrawBg, mDrawBgDetail, mDrawDetail, mDrawForeground };
+
+	int firstCol = chunkX * GameField::CHUNK_SIZE;
+	int firstRow = chunkY * GameField::CHUNK_SIZE;
+	int count = std::min(GameField::CHUNK_SIZE, width() - firstCol);
+	int lastRow = std::min(firstRow + GameField::CHUNK_SIZE, height());
+
+	for(int row = firstRow; row < lastRow; row++)
 	{
-		for(int col = tileUpperLeft.x(); col <= tileLowerRight.x() && col < width(); col++)
+		float y = static_cast<float>((row - firstRow) * tileHeight);
+
+		const GameField::TileIndex* spans[Cell::LAYER_COUNT];
+		for(int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+			spans[layer] = mField.span(static_cast<Cell::TileLayer>(layer), firstCol, row);
+
+		for(int i = 0; i < count; i++)
 		{
-			Cell cell = mField.cell(col, row);
-			
-			int rasterX = mViewport.x() + ((col - tileUpperLeft.x()) * mTileset.width()) - offsetX + mViewport.x();
-			int rasterY = mViewport.y() + ((row - tileUpperLeft.y()) * mTileset.height()) - offsetY + mViewport.y();
+			// Anything beneath the topmost opaque tile is never seen so start there.
+			int firstLayer = 0;
+			for(int layer = Cell::LAYER_COUNT - 1; layer > 0; layer--)
+			{
+				if(draw[layer] && mTileset.opacity(spans[layer][i]) == Tileset::TILE_OPAQUE)
+				{
+					firstLayer = layer;
+					break;
+				}
+			}
+
+			for(int layer = firstLayer; layer < Cell::LAYER_COUNT; layer++)
+			{
+				int index = spans[layer][i];
+				if(!draw[layer] || mTileset.opacity(index) == Tileset::TILE_EMPTY)
+					continue;
+
+				// Layers only have to be kept apart when their tiles can be on different pages.
+				TileBatch& target = layer == Cell::LAYER_FOREGROUND ? batch.above : batch.below;
+				target.addTile(mTileset.pageCount() > 1 ? layer : 0, mTileset.page(index), mTileset.textureCoords(index), static_cast<float>(i * tileWidth), y, static_cast<float>(tileWidth), static_cast<float>(tileHeight));
+			}
+		}
 
-			if(mDrawForeground && cell.index(Cell::LAYER_FOREGROUND) >= 0)
-				mTileset.drawTile(cell.index(Cell::LAYER_FOREGROUND), rasterX, rasterY);
+		if(mDrawCollision)
+		{
+			for(int i = 0; i < count; i++)
+			{
+				if(mField.blocked(firstCol + i, row))
+					batch.above.addBoxFilled(static_cast<float>(i * tileWidth), y, static_cast<float>(CELL_DIMENSIONS.w()), static_cast<float>(CELL_DIMENSIONS.h()), Color_4ub(255, 0, 0, 65));
+			}
+		}
+	}
 
-			if(mDrawCollision && cell.blocked())
-				r.drawBoxFilled(static_cast<float>(rasterX), static_cast<float>(rasterY), static_cast<float>(CELL_DIMENSIONS.w()), static_cast<float>(CELL_DIMENSIONS.h()), 255, 0, 0, 65);
-			
-			if(mShowLinks && cell.linked())
-				r.drawBox(static_cast<float>(rasterX), static_cast<float>(rasterY), static_cast<float>(CELL_DIMENSIONS.w()), static_cast<float>(CELL_DIMENSIONS.h()), 255, 255, 0);
+	if(mShowLinks)
+	{
+		for(LinkTable::const_iterator it = links().begin(); it != links().end(); ++it)
+		{
+			const LinkTable::Link& link = it->second;
+			if((link.x >> GameField::CHUNK_SHIFT) != chunkX || (link.y >> GameField::CHUNK_SHIFT) != chunkY)
+				continue;
 
+			batch.above.addBox(static_cast<float>((link.x - firstCol) * tileWidth), static_cast<float>((link.y - firstRow) * tileHeight), static_cast<float>(CELL_DIMENSIONS.w()), static_cast<float>(CELL_DIMENSIONS.h()), Color_4ub(255, 255, 0, 255));
 		}
 	}
+}
+
 
+/**
+ * Marks all chunk batches as stale. Used when something other than the
+ * contents of the GameField changes what a batch draws.
+ */
+void Map::invalidateBatches()
+{
+	for(ChunkBatchTable::iterator it = mChunkBatches.begin(); it != mChunkBatches.end(); ++it)
+		it->second.built = false;
+}
+
+
+/**
+ * Releases the batches of chunks that haven't been drawn in a while.
+ */
+void Map::trimBatches()
+{
+	if(mFrame % BATCH_LIFETIME != 0)
+		return;
+
+	for(ChunkBatchTable::iterator it = mChunkBatches.begin(); it != mChunkBatches.end(); )
+	{
+		if(mFrame - it->second.lastFrame > BATCH_LIFETIME)
+			it = mChunkBatches.erase(it);
+		else
+			++it;
+	}
+}
+
+
+/**
+ * Gets the number of bytes of geometry held by cached chunk batches.
+ */
+size_t Map::batchBytes() const
+{
+	size_t bytes = 0;
+	for(ChunkBatchTable::const_iterator it = mChunkBatches.begin(); it != mChunkBatches.end(); ++it)
+		bytes += it->second.below.bytes() + it->second.above.bytes();
+
+	return bytes;
 }
 
 
@@ -413,7 +590,7 @@ Point_2d Map::getGridCoords(const Point_2d& _pt) const
  * 
  * \note	Provides basic bounds checking.
  */
-Cell& Map::getCell(const Point_2d& _pt)
+Cell Map::getCell(const Point_2d& _pt)
 {
 	Point_2d pt = getGridCoords(_pt);
 
@@ -427,10 +604,10 @@ Cell& Map::getCell(const Point_2d& _pt)
  * Gets a cell by the grid coordinates it occupies.
  * 
  * \warning	This function performs no error checking or correcting
- *			so asking for out-of-bound cells will result in thrown
- *			exceptions.
+ *			so asking for out-of-bound cells will result in undefined
+ *			behavior.
  */
-Cell& Map::getCellByGridCoords(const Point_2d& grid)
+Cell Map::getCellByGridCoords(const Point_2d& grid)
 {
 	return getCellByGridCoords(grid.x(), grid.y());
 }
@@ -440,10 +617,10 @@ Cell& Map::getCellByGridCoords(const Point_2d& grid)
  * Gets a cell by the grid coordinates it occupies.
  * 
  * \warning	This function performs no error checking or correcting
- *			so asking for out-of-bound cells will result in thrown
- *			exceptions.
+ *			so asking for out-of-bound cells will result in undefined
+ *			behavior.
  */
-Cell& Map::getCellByGridCoords(int x, int y)
+Cell Map::getCellByGridCoords(int x, int y)
 {
 	return mField.cell(x, y);
 }
@@ -498,18 +675,91 @@ void Map::setCamera(float x, float y)
 }
 
 
+/**
+ * Loads a map in either the XML or the binary format depending
+ * on its file extension.
+ */
 void Map::load(const std::string& filepath)
 {
+	TraceScope trace("Map::load", "map");
+
+	if(isBinaryMapPath(filepath))
+		loadBinary(filepath);
+	else
+		loadXml(filepath);
+
+	mCameraSpace = Rectangle_2d(0, 0, mField.width() * mTileset.width() - mViewport.w(), mField.height() * mTileset.height() - mViewport.h());
+}
+
+
+/**
+ * Records a problem found while loading the map. Anything that stops the
+ * load early or drops part of the map is recorded so that callers can tell
+ * a truncated map from a complete one.
+ */
+void Map::loadError(const std::string& message)
+{
+	mLoadErrors.push_back(message);
+}
+
+
+/**
+ * Splits the <levels> section out of a map document.
+ * 
+ * \param	bytes	Map document. Must be null terminated.
+ * \param	levels	Set to the contents of the <levels> section. Both pointers
+ *					are null if the document doesn't have one.
+ * 
+ * \return	The document with the contents of the <levels> section replaced
+ *			by as many line breaks as it spanned so that rows reported by
+ *			TinyXML still match the file.
+ */
+static string splitLevels(const char* bytes, size_t size, pair<const char*, const char*>& levels)
+{
+	levels = make_pair(static_cast<const char*>(nullptr), static_cast<const char*>(nullptr));
+
+	const char* end = bytes + size;
+	const char* open = strstr(bytes, "<levels");
+	while(open && open[7] != '>' && open[7] != '/' && !isspace(static_cast<unsigned char>(open[7])))
+		open = strstr(open + 7, "<levels");
+
+	const char* openEnd = open ? strchr(open, '>') : nullptr;
+	if(!openEnd || openEnd[-1] == '/')
+		return string(bytes, size);
+
+	const char* close = strstr(openEnd, "</levels");
+	if(!close)
+		return string(bytes, size);
+
+	levels = make_pair(openEnd + 1, close);
+
+	string document(bytes, openEnd + 1);
+	document.append(count(openEnd + 1, close, '\n'), '\n');
+	document.append(close, end);
+
+	return document;
+}
+
+
+void Map::loadXml(const std::string& filepath)
+{
+	TraceScope trace("Map::loadXml", "map");
+
 	File xmlFile = Utility<Filesystem>::get().open(filepath);
 
 	TiXmlDocument doc;
 	TiXmlElement  *root;
 
+	// The levels section makes up nearly all of a map file so it's read in place by
+	// parseLevels() instead of being turned into a DOM with a node for every cell.
+	pair<const char*, const char*> levels;
+	string document = splitLevels(xmlFile.raw_bytes(), static_cast<size_t>(xmlFile.size()), levels);
+
 	// Load the XML document and handle any errors if occuring
-	doc.Parse(xmlFile.raw_bytes());
+	doc.Parse(document.c_str());
 	if(doc.Error())
 	{
-		cout << "Malformed map file. Error on Row " << doc.ErrorRow() << ", Column " << doc.ErrorCol() << ": " << doc.ErrorDesc() << endl;
+		loadError("Malformed map file. Error on Row " + to_string(doc.ErrorRow()) + ", Column " + to_string(doc.ErrorCol()) + ": " + doc.ErrorDesc());
 		return;
 	}
 	else
@@ -518,7 +768,7 @@ void Map::load(const std::string& filepath)
 		root = doc.FirstChildElement("map");
 		if(root == 0)
 		{
-			cout << "Root element in '" << filepath << "' is not 'map'." << endl;
+			loadError("Root element in '" + filepath + "' is not 'map'.");
 			return;
 		}
 
@@ -528,21 +778,26 @@ void Map::load(const std::string& filepath)
 		TiXmlNode* node = 0;
 		while(node = root->IterateChildren(node))
 		{
+			if(mProgress && mProgress->cancelled())
+			{
+				loadError("Loading cancelled.");
+				return;
+			}
+
 			if(node->ValueStr() == "properties")
 				parseProperties(node);
 			else if(node->ValueStr() == "tilesets")
 				parseTilesets(node);
 			else if(node->ValueStr() == "levels")
-				parseLevels(node);
+				parseLevels(levels.first, levels.second);
 			else if(node->ValueStr() == "objects")
 				parseObjects(node);
 			else if(node->ValueStr() == "links")
 				parseLinks(node);
 			else
-				cout << "Unexpected tag '<" << node->ValueStr() << ">' found in '" << filepath << "' on row " << node->Row() << "." << endl;
+				loadError("Unexpected tag '<" + node->ValueStr() + ">' found in '" + filepath + "' on row " + to_string(node->Row()) + ".");
 		}
 
-		mCameraSpace = Rectangle_2d(0, 0, mField.width() * mTileset.width() - mViewport.w(), mField.height() * mTileset.height() - mViewport.h());
 		//mFieldLoops = Point_2d(mViewport.w / mTileset.width() + 1, mViewport.h / mTileset.height() + 1);
 	}
 }
@@ -550,6 +805,8 @@ void Map::load(const std::string& filepath)
 
 void Map::parseProperties(TiXmlNode* node)
 {
+	TraceScope trace("Map::parseProperties", "map");
+
 	XmlAttributeParser parser;
 
 	TiXmlNode *xmlNode = 0;
@@ -572,7 +829,7 @@ void Map::parseProperties(TiXmlNode* node)
 			int height = parser.intAttribute(xmlNode, "height");
 
 			if(width != CELL_DIMENSIONS.w() || height != CELL_DIMENSIONS.h())
-				cout << "Tile sizes other than " << CELL_DIMENSIONS.w() << "x" << CELL_DIMENSIONS.h() << " pixels not supported." << endl;
+				loadError("Tile sizes other than " + to_string(CELL_DIMENSIONS.w()) + "x" + to_string(CELL_DIMENSIONS.h()) + " pixels not supported.");
 		}
 		else if(xmlNode->ValueStr() == "bg_music")
 		{
@@ -589,13 +846,15 @@ void Map::parseProperties(TiXmlNode* node)
 			mEdgeExit = true;
 		}
 		else
-			cout << "Unexpected tag '<" << xmlNode->ValueStr() << ">' found in map file on row " << xmlNode->Row() << "." << endl;
+			loadError("Unexpected tag '<" + xmlNode->ValueStr() + ">' found in map file on row " + to_string(xmlNode->Row()) + ".");
 	}
 }
 
 
 void Map::parseTilesets(TiXmlNode* node)
 {
+	TraceScope trace("Map::parseTilesets", "map");
+
 	XmlAttributeParser parser;
 
 	TiXmlNode *xmlNode = 0;
@@ -608,54 +867,207 @@ void Map::parseTilesets(TiXmlNode* node)
 			if (!Utility<Filesystem>::get().exists(tsetpath))
 				throw Exception(0, "Missing TileSet", "Referened TileSet missing: " + tsetpath);
 
-			mTileset = Tileset(tsetpath, CELL_DIMENSIONS.w(), CELL_DIMENSIONS.h());
+			if(mProgress)
+				mProgress->stage(LoadProgress::STAGE_TILESET);
+
+			mTileset = Tileset(tsetpath, CELL_DIMENSIONS.w(), CELL_DIMENSIONS.h(), mProgress);
 		}
 		else
-			cout << "Unexpected tag '<" << xmlNode->ValueStr() << ">' found in map file on row " << xmlNode->Row() << "." << endl;
+			loadError("Unexpected tag '<" + xmlNode->ValueStr() + ">' found in map file on row " + to_string(xmlNode->Row()) + ".");
 	}
 }
 
 
-void Map::parseLevels(TiXmlNode* node)
+/**
+ * Copies the decoded values of a single layer into a GameField.
+ * 
+ * \param	layer	Cell::TileLayer or Cell::LAYER_COUNT for collision.
+ */
+static void applyLayer(GameField& field, int layer, const std::vector<GameField::TileIndex>& values)
 {
-	XmlAttributeParser parser;
+	for(int row = 0, i = 0; row < field.height(); row++)
+	{
+		for(int col = 0; col < field.width(); col++, i++)
+		{
+			if(layer == Cell::LAYER_COUNT)
+				field.blocked(col, row, values[i] != 0);
+			else
+				field.index(static_cast<Cell::TileLayer>(layer), col, row, values[i]);
+		}
+	}
+}
 
-	TiXmlNode *xmlNode = 0;
-	while(xmlNode = node->IterateChildren(xmlNode))
+
+/**
+ * Reads the contents of the <levels> section straight into the GameField.
+ */
+void Map::parseLevels(const char* begin, const char* end)
+{
+	TraceScope trace("Map::parseLevels", "map");
+
+	if(!begin)
+		return;
+
+	XmlPullReader reader(begin, end);
+	XmlPullReader::Attribute attribute;
+
+	int depth = 0;
+	bool inLevel = false;
+	LevelEncoding encoding = ENCODING_TEXT;
+	int layer = -1;
+	int cellCounter = 0;
+	int w = mField.width();
+	int cellCount = mField.width() * mField.height();
+
+	std::vector<GameField::TileIndex> values;
+
+	if(mProgress)
+		mProgress->stage(LoadProgress::STAGE_READING);
+
+	XmlPullReader::Token token;
+	for(int tokens = 0; (token = reader.next()) != XmlPullReader::TOKEN_EOF; tokens++)
 	{
-		if(xmlNode->ValueStr() == "level")
+		if(mProgress && (tokens & 4095) == 0)
 		{
-			int cellCounter = 0;
-			int w = mField.width();
-			
-			TiXmlNode* cellNode = 0;
-			while(cellNode = xmlNode->IterateChildren(cellNode))
+			if(mProgress->cancelled())
 			{
-				int bg_index = parser.intAttribute(cellNode, "bg_index");
-				int bgdetail_index = parser.intAttribute(cellNode, "bgd_index");
-				int detail_index = parser.intAttribute(cellNode, "d_index");
-				int fg_index = parser.intAttribute(cellNode, "fg_index");
-				string blocked = toLowercase(parser.stringAttribute(cellNode, "blocked"));
-
-				int col = cellCounter % w;
-				int row = cellCounter / w;
-				mField.cell(col, row).index(Cell::LAYER_BASE, bg_index);
-				mField.cell(col, row).index(Cell::LAYER_BASE_DETAIL, bgdetail_index);
-				mField.cell(col, row).index(Cell::LAYER_DETAIL, detail_index);
-				mField.cell(col, row).index(Cell::LAYER_FOREGROUND, fg_index);
-				
-				blocked == "true" ? mField.cell(col, row).blocked(true) : mField.cell(col, row).blocked(false) ;
-
-				cellCounter++;
+				loadError("Loading cancelled.");
+				return;
 			}
 
-			if(cellCounter < (mField.width() * mField.height()))
-				cout << "WARNING: Map doesn't define enough cells." << endl;
-			else if(cellCounter > (mField.width() * mField.height()))
-				cout << "WARNING: Map defines to many cells." << endl;
+			mProgress->progress(static_cast<float>(reader.position() - begin) / (end - begin));
 		}
-		else
-			cout << "Unexpected tag '<" << xmlNode->ValueStr() << ">' found in map file on row " << xmlNode->Row() << "." << endl;
+
+		if(token == XmlPullReader::TOKEN_ERROR)
+		{
+			loadError("Malformed levels section in map file.");
+			return;
+		}
+
+		if(token == XmlPullReader::TOKEN_END)
+		{
+			if(--depth == 0 && inLevel && encoding == ENCODING_TEXT)
+			{
+				if(cellCounter < cellCount)
+					loadError("WARNING: Map doesn't define enough cells.");
+				else if(cellCounter > cellCount)
+					loadError("WARNING: Map defines to many cells.");
+			}
+
+			layer = -1;
+			continue;
+		}
+
+		if(token == XmlPullReader::TOKEN_TEXT)
+		{
+			// Contents of a <layer> element of an encoded level.
+			if(depth != 2 || layer < 0)
+				continue;
+
+			values.resize(cellCount);
+			if(decodeLayer(encoding, reader.text(), reader.textLength(), values))
+				applyLayer(mField, layer, values);
+			else
+				loadError("WARNING: Layer '" + string(LAYER_NAMES[layer]) + "' is malformed or doesn't define the right number of cells.");
+
+			layer = -1;
+			continue;
+		}
+
+		int tagDepth = token == XmlPullReader::TOKEN_START ? depth++ : depth;
+
+		if(tagDepth == 0)
+		{
+			inLevel = reader.isName("level");
+			if(!inLevel)
+				loadError("Unexpected tag '<" + string(reader.name(), reader.nameLength()) + ">' found in levels section of map file.");
+
+			encoding = ENCODING_TEXT;
+			while(reader.nextAttribute(attribute))
+			{
+				if(attribute.is("encoding"))
+					encoding = ::levelEncoding(attribute.value, attribute.valueLength);
+			}
+
+			if(inLevel && encoding == ENCODING_UNKNOWN)
+			{
+				loadError("Unsupported level encoding in map file. Level will be ignored.");
+				inLevel = false;
+			}
+
+			// Maps are saved in the encoding they were loaded with. Other
+			// encodings are opt-in, readers of MAP_DRIVER_VERSION maps
+			// that predate them would see a map of empty cells.
+			if(inLevel)
+				mLevelEncoding = encoding;
+
+			cellCounter = 0;
+			if(inLevel && encoding == ENCODING_TEXT && token == XmlPullReader::TOKEN_EMPTY && cellCount > 0)
+				loadError("WARNING: Map doesn't define enough cells.");
+
+			continue;
+		}
+
+		// Only direct children of a level are cells or layers.
+		if(tagDepth != 1 || !inLevel)
+			continue;
+
+		if(encoding != ENCODING_TEXT)
+		{
+			layer = -1;
+			if(!reader.isName("layer") || token != XmlPullReader::TOKEN_START)
+				continue;
+
+			while(reader.nextAttribute(attribute))
+			{
+				if(!attribute.is("name"))
+					continue;
+
+				for(int i = 0; i <= Cell::LAYER_COUNT; i++)
+				{
+					if(strlen(LAYER_NAMES[i]) == attribute.valueLength && memcmp(LAYER_NAMES[i], attribute.value, attribute.valueLength) == 0)
+						layer = i;
+				}
+			}
+
+			if(layer < 0)
+				loadError("Unknown layer found in levels section of map file. Layer will be ignored.");
+
+			continue;
+		}
+
+		if(cellCounter >= cellCount)
+		{
+			cellCounter++;
+			continue;
+		}
+
+		int bg_index = 0, bgdetail_index = 0, detail_index = 0, fg_index = 0;
+		bool blocked = false;
+
+		while(reader.nextAttribute(attribute))
+		{
+			if(attribute.is("bg_index"))
+				bg_index = XmlPullReader::toInt(attribute.value, attribute.valueLength);
+			else if(attribute.is("bgd_index"))
+				bgdetail_index = XmlPullReader::toInt(attribute.value, attribute.valueLength);
+			else if(attribute.is("d_index"))
+				detail_index = XmlPullReader::toInt(attribute.value, attribute.valueLength);
+			else if(attribute.is("fg_index"))
+				fg_index = XmlPullReader::toInt(attribute.value, attribute.valueLength);
+			else if(attribute.is("blocked"))
+				blocked = XmlPullReader::isTrue(attribute.value, attribute.valueLength);
+		}
+
+		int col = cellCounter % w;
+		int row = cellCounter / w;
+		mField.index(Cell::LAYER_BASE, col, row, bg_index);
+		mField.index(Cell::LAYER_BASE_DETAIL, col, row, bgdetail_index);
+		mField.index(Cell::LAYER_DETAIL, col, row, detail_index);
+		mField.index(Cell::LAYER_FOREGROUND, col, row, fg_index);
+		mField.blocked(col, row, blocked);
+
+		cellCounter++;
 	}
 }
 
@@ -667,11 +1079,13 @@ void Map::parseObjects(TiXmlNode* node)
 
 void Map::parseLinks(TiXmlNode* node)
 {
+	TraceScope trace("Map::parseLinks", "map");
+
 	XmlAttributeParser parser;
 
 	if(mField.empty())
 	{
-		cout << "WARNING: Links section defined before levels or no cells were defined. Links will be ignored." << endl;
+		loadError("WARNING: Links section defined before levels or no cells were defined. Links will be ignored.");
 		return;
 	}
 
@@ -687,207 +1101,273 @@ void Map::parseLinks(TiXmlNode* node)
 			int row = parser.intAttribute(xmlNode, "row");
 			int col = parser.intAttribute(xmlNode, "col");
 
-			Cell& _c = mField.cell(row, col);
-			_c.link(destination);
-			_c.link_destination(Point_2d(dest_x, dest_y));
+			if(row < 0 || row >= mField.width() || col < 0 || col >= mField.height())
+			{
+				loadError("WARNING: Link on row " + to_string(xmlNode->Row()) + " is outside of the map. Link will be ignored.");
+				continue;
+			}
+
+			mField.link(row, col, destination, Point_2d(dest_x, dest_y));
 		}
 		else
-			cout << "Unexpected tag '<" << xmlNode->ValueStr() << ">' found in map file on row " << xmlNode->Row() << "." << endl;
+			loadError("Unexpected tag '<" + xmlNode->ValueStr() + ">' found in map file on row " + to_string(xmlNode->Row()) + ".");
 	}
 }
 
 
+/**
+ * Saves the map in either the XML or the binary format depending
+ * on the file extension.
+ */
 void Map::save(const std::string& filePath)
 {
-	TiXmlDocument doc;
+	TraceScope trace("Map::save", "map");
+
+	if(!save(snapshot(), filePath))
+		cout << "Unable to save map '" << filePath << "'." << endl;
+}
+
+
+/**
+ * Takes a snapshot of the map for saving.
+ */
+MapSnapshot Map::snapshot() const
+{
+	MapSnapshot snapshot;
+
+	snapshot.name = mName;
+	snapshot.bgMusic = mBgMusic;
+	snapshot.tilesetPath = mTileset.filepath();
+	snapshot.edgeExitDestination = mEdgeExitDestination;
+	snapshot.edgeExitPosition = mEdgeExitPosition;
+	snapshot.field = mField;
+	snapshot.levelEncoding = mLevelEncoding;
+	snapshot.showTitlePlaque = mShowTitlePlaque;
+	snapshot.edgeExit = mEdgeExit;
+
+	return snapshot;
+}
+
+
+/**
+ * Saves a snapshot of a map in either the XML or the binary format
+ * depending on the file extension.
+ * 
+ * The file is written next to its destination and renamed over it once
+ * it's complete so the destination is never left half written.
+ * 
+ * \note	Doesn't touch the Map, the Renderer or OpenGL so it's safe to
+ *			call from a worker thread.
+ */
+bool Map::save(const MapSnapshot& snapshot, const std::string& filePath)
+{
+	TraceScope trace("Map::save(snapshot)", "map");
+
+	if(isBinaryMapPath(filePath))
+		return writeFileAtomic(filePath, serializeBinary(snapshot));
+
+	return writeFileAtomic(filePath, [&snapshot](std::ostream& stream)
+	{
+		XmlWriter writer(stream);
+		return writeXml(snapshot, writer) && writer.flush();
+	});
+}
+
+
+/**
+ * Writes a map snapshot in the XML format.
+ * 
+ * Cells are formatted straight into the writer's buffer. Encoded levels
+ * are encoded a row at a time, nothing the size of a layer is built up.
+ * 
+ * \return	False if a layer couldn't be encoded. The writer is left with
+ *			a partial document.
+ */
+bool Map::writeXml(const MapSnapshot& snapshot, XmlWriter& writer)
+{
+	TraceScope trace("Map::writeXml", "map");
 
-	//TiXmlComment *comment = new TiXmlComment("Automatically generated Configuration file. This is best left untouched.");
-	//doc->LinkEndChild(comment);
+	const GameField& field = snapshot.field;
+
+	writer.startElement("map");
+	writer.attribute("version", MAP_DRIVER_VERSION);
 
-	TiXmlElement* root = new TiXmlElement("map");
-	root->SetAttribute("version", MAP_DRIVER_VERSION);
-	doc.LinkEndChild(root);
 
-	
 	// ==========================================
 	// MAP PROPERTIES
 	// ==========================================
-	TiXmlElement *properties = new TiXmlElement("properties");
-	root->LinkEndChild(properties);
+	writer.startElement("properties");
 
-	TiXmlElement *mapname = new TiXmlElement("mapname");
-	mapname->SetAttribute("name", mName);
-	properties->LinkEndChild(mapname);
+	writer.startElement("mapname");
+	writer.attribute("name", snapshot.name);
+	writer.endElement();
 
-	TiXmlElement *mapsize = new TiXmlElement("mapsize");
-	mapsize->SetAttribute("width", mField.width());
-	mapsize->SetAttribute("height", mField.height());
-	properties->LinkEndChild(mapsize);
+	writer.startElement("mapsize");
+	writer.attribute("width", field.width());
+	writer.attribute("height", field.height());
+	writer.endElement();
 
-	TiXmlElement *bg_music = new TiXmlElement("bg_music");
-	bg_music->SetAttribute("path", mBgMusic);
-	properties->LinkEndChild(bg_music);
+	writer.startElement("bg_music");
+	writer.attribute("path", snapshot.bgMusic);
+	writer.endElement();
 
-	TiXmlElement *title_plaque = new TiXmlElement("title_plaque");
-	showTitlePlaque() ? title_plaque->SetAttribute("show", "true") : title_plaque->SetAttribute("show", "false");
-	properties->LinkEndChild(title_plaque);
+	writer.startElement("title_plaque");
+	writer.attribute("show", snapshot.showTitlePlaque ? "true" : "false");
+	writer.endElement();
 
-	TiXmlElement *tilesize = new TiXmlElement("tilesize");
-	tilesize->SetAttribute("width", CELL_DIMENSIONS.w());
-	tilesize->SetAttribute("height", CELL_DIMENSIONS.h());
-	properties->LinkEndChild(tilesize);
+	writer.startElement("tilesize");
+	writer.attribute("width", CELL_DIMENSIONS.w());
+	writer.attribute("height", CELL_DIMENSIONS.h());
+	writer.endElement();
 
-	if(mEdgeExit)
+	if(snapshot.edgeExit)
 	{
-		TiXmlElement *edge_exit = new TiXmlElement("edge_exit");
-		edge_exit->SetAttribute("destination", mEdgeExitDestination);
-		edge_exit->SetAttribute("dest_x", mEdgeExitPosition.x());
-		edge_exit->SetAttribute("dest_y", mEdgeExitPosition.y());
-		properties->LinkEndChild(edge_exit);
+		writer.startElement("edge_exit");
+		writer.attribute("destination", snapshot.edgeExitDestination);
+		writer.attribute("dest_x", snapshot.edgeExitPosition.x());
+		writer.attribute("dest_y", snapshot.edgeExitPosition.y());
+		writer.endElement();
 	}
 
+	writer.endElement();
+
 
 	// ==========================================
 	// TILE SETS
 	// ==========================================
-	TiXmlElement *tilesets = new TiXmlElement("tilesets");
-	root->LinkEndChild(tilesets);
+	writer.startElement("tilesets");
 
-	TiXmlElement *tileset = new TiXmlElement("tileset");
-	tileset->SetAttribute("path", mTileset.filepath());
-	tilesets->LinkEndChild(tileset);
+	writer.startElement("tileset");
+	writer.attribute("path", snapshot.tilesetPath);
+	writer.endElement();
+
+	writer.endElement();
 
 
 	// ==========================================
 	// LEVELS
 	// ==========================================
-	TiXmlElement *levels = new TiXmlElement("levels");
-	root->LinkEndChild(levels);
+	writer.startElement("levels");
 
-	TiXmlElement *level = new TiXmlElement("level");
-	level->SetAttribute("id", 0);
-	level->SetAttribute("encoding", "TEXT");
-	levels->LinkEndChild(level);
+	writer.startElement("level");
+	writer.attribute("id", 0);
+	writer.attribute("encoding", levelEncodingName(snapshot.levelEncoding));
 
-	for(int row = 0; row < mField.height(); row++)
+	if(snapshot.levelEncoding == ENCODING_TEXT)
 	{
-		for(int col = 0; col < mField.width(); col++)
+		for(int row = 0; row < field.height(); row++)
 		{
-			Cell& _cell = mField.cell(col, row);
-			TiXmlElement *cell = new TiXmlElement("cell");
-
-			cell->SetAttribute("bgtset", 0);
-			cell->SetAttribute("bg_index", _cell.index(Cell::LAYER_BASE));
-			cell->SetAttribute("bgd_tset", 0);
-			cell->SetAttribute("bgd_index", _cell.index(Cell::LAYER_BASE_DETAIL));
-			cell->SetAttribute("d_tset", 0);
-			cell->SetAttribute("d_index", _cell.index(Cell::LAYER_DETAIL));
-			cell->SetAttribute("fg_tset", 0);
-			cell->SetAttribute("fg_index", _cell.index(Cell::LAYER_FOREGROUND));
-			_cell.blocked() ? cell->SetAttribute("blocked", "true") : cell->SetAttribute("blocked", "false");
-
-			level->LinkEndChild(cell);
+			for(int col = 0; col < field.width(); )
+			{
+				const GameField::TileIndex* base = field.span(Cell::LAYER_BASE, col, row);
+				const GameField::TileIndex* baseDetail = field.span(Cell::LAYER_BASE_DETAIL, col, row);
+				const GameField::TileIndex* detail = field.span(Cell::LAYER_DETAIL, col, row);
+				const GameField::TileIndex* foreground = field.span(Cell::LAYER_FOREGROUND, col, row);
+
+				int count = std::min(GameField::spanLength(col), field.width() - col);
+				for(int i = 0; i < count; i++, col++)
+				{
+					writer.startElement("cell");
+					writer.attribute("bg_index", base[i]);
+					writer.attribute("bgd_index", baseDetail[i]);
+					writer.attribute("d_index", detail[i]);
+					writer.attribute("fg_index", foreground[i]);
+					writer.attribute("blocked", field.blocked(col, row) ? "true" : "false");
+					writer.endElement();
+				}
+			}
 		}
 	}
+	else
+	{
+		// Layers are encoded a row at a time straight into the writer.
+		std::vector<GameField::TileIndex> values(field.width());
+		std::string text;
 
+		for(int layer = 0; layer <= Cell::LAYER_COUNT; layer++)
+		{
+			writer.startElement("layer");
+			writer.attribute("name", LAYER_NAMES[layer]);
 
-	// ==========================================
-	// OBJECTS
-	// ==========================================
-	TiXmlElement *objects = new TiXmlElement("objects");
-	root->LinkEndChild(objects);
-
-
-	// ==========================================
-	// MAP LINKS
-	// ==========================================
-	TiXmlElement *links = new TiXmlElement("links");
-	root->LinkEndChild(links);
+			LayerEncoder encoder(snapshot.levelEncoding, text);
 
-	for(int col = 0; col < mField.height(); col++)
-	{
-		for(int row = 0; row < mField.width(); row++)
-		{
-			if(mField.cell(row, col).linked())
+			for(int row = 0; row < field.height(); row++)
 			{
-				Cell& _c = mField.cell(row, col);
+				if(layer == Cell::LAYER_COUNT)
+				{
+					for(int col = 0; col < field.width(); col++)
+						values[col] = field.blocked(col, row) ? 1 : 0;
+				}
+				else
+				{
+					for(int col = 0; col < field.width(); )
+					{
+						const GameField::TileIndex* span = field.span(static_cast<Cell::TileLayer>(layer), col, row);
+						int count = std::min(GameField::spanLength(col), field.width() - col);
+						std::copy(span, span + count, &values[col]);
+						col += count;
+					}
+				}
+
+				if(!encoder.row(values.data(), field.width()))
+				{
+					cout << "Unable to encode layer '" << LAYER_NAMES[layer] << "'." << endl;
+					return false;
+				}
+
+				writer.text(text);
+				text.clear();
+			}
 
-				TiXmlElement* link = new TiXmlElement("link");
+			if(!encoder.finish())
+			{
+				cout << "Unable to encode layer '" << LAYER_NAMES[layer] << "'." << endl;
+				return false;
+			}
 
-				link->SetAttribute("row", row);
-				link->SetAttribute("col", col);
-				link->SetAttribute("destination", _c.link());
-				link->SetAttribute("dest_x", _c.link_destination().x());
-				link->SetAttribute("dest_y", _c.link_destination().y());
+			writer.text(text);
+			text.clear();
 
-				links->LinkEndChild(link);
-			}
+			writer.endElement();
 		}
 	}
 
+	writer.endElement();
+	writer.endElement();
 
-	// Write out the XML file.
-	TiXmlPrinter printer;
-	doc.Accept(&printer);
 
-	Utility<Filesystem>::get().write(File(printer.Str(), filePath));
-}
+	// ==========================================
+	// OBJECTS
+	// ==========================================
+	writer.startElement("objects");
+	writer.endElement();
 
 
-/**
- * Dumps the whole map to a BMP file.
- * 
- * \note	This code uses a number of hacks provided by
- *			SDL to save an image to disk. It may be better
- *			to move some of this code over into Image so
- *			that this feature could be usable in NAS2D.
- * 
- * \warning	This function makes no attempt to trap memory
- * 			allocation errors. Should an allocation error
- * 			occur, this function will cause a crash.
- * 
- * \todo	Add memory allocation error traps to prevent
- *			possible crashing.
- * 
- * \todo	Ensure that there are no memory leaks associated
- *			with this function.
- */
-void Map::dump(const std::string& filePath)
-{
-	/*
-	Image img(mField.width() * CELL_DIMENSIONS.w, mField.height() * CELL_DIMENSIONS.h);
+	// ==========================================
+	// MAP LINKS
+	// ==========================================
+	writer.startElement("links");
 
-	for(int row = 0; row < mField.height(); row++)
+	// The 'row' and 'col' attributes hold the X and Y coordinates respectively.
+	std::vector<const LinkTable::Link*> linkList = field.links().sorted();
+	for(size_t i = 0; i < linkList.size(); i++)
 	{
-		for(int col = 0; col < mField.width(); col++)
-		{
-			Cell cell = mField.cell(col, row);
-
-			mTileset.drawTileToImage(img, cell.index(Cell::LAYER_BASE), col * CELL_DIMENSIONS.w, row * CELL_DIMENSIONS.h);
-			mTileset.drawTileToImage(img, cell.index(Cell::LAYER_BASE_DETAIL), col * CELL_DIMENSIONS.w, row * CELL_DIMENSIONS.h);
-			mTileset.drawTileToImage(img, cell.index(Cell::LAYER_DETAIL), col * CELL_DIMENSIONS.w, row * CELL_DIMENSIONS.h);
-			mTileset.drawTileToImage(img, cell.index(Cell::LAYER_FOREGROUND), col * CELL_DIMENSIONS.w, row * CELL_DIMENSIONS.h);
-		}
+		const LinkTable::Link* _l = linkList[i];
+
+		writer.startElement("link");
+		writer.attribute("row", _l->x);
+		writer.attribute("col", _l->y);
+		writer.attribute("destination", field.links().name(_l->destination));
+		writer.attribute("dest_x", _l->position.x());
+		writer.attribute("dest_y", _l->position.y());
+		writer.endElement();
 	}
 
-	SDL_Surface* surface = img.pixels();
-	SDL_RWops* rw = SDL_RWFromMem(surface->pixels, surface->pitch * surface->h);
-
-	SDL_SaveBMP_RW(surface, rw, 0);
+	writer.endElement();
 
-	string bytestream;
+	writer.endElement();
 
-	Uint8* pt = rw->hidden.mem.base;
-	while(pt != rw->hidden.mem.stop)
-	{
-		bytestream.append((char*)pt, 1);
-		pt++;
-	}
-	SDL_FreeRW(rw);
-
-	File file(bytestream, filePath);
-	Utility<Filesystem>::get().write(file);
-	*/
+	return true;
 }
 
 
@@ -5,27 +5,68 @@
 #include "NAS2D/NAS2D.h"
 
 #include "GameField.h"
+#include "LevelEncoding.h"
+#include "LoadProgress.h"
+#include "TileBatch.h"
 #include "Tileset.h"
 
 #include "Entity.h"
 
 #include <string>
+#include <unordered_map>
+
+class XmlWriter;
 
 extern const std::string MAP_DRIVER_VERSION;
 
+extern const unsigned int MAP_BINARY_VERSION;
+extern const std::string MAP_BINARY_EXTENSION;
+
+extern const Rectangle_2d CELL_DIMENSIONS;
+
+bool isBinaryMapPath(const std::string& path);
+unsigned int binaryMapVersion(const std::string& path);
+
+std::string nativePath(const std::string& path);
+
+
+/**
+ * Copy of everything that's written out when a Map is saved.
+ * 
+ * Taking one is cheap as the GameField's chunks are shared copy-on-write,
+ * it can be serialized on another thread while the Map keeps being edited.
+ */
+struct MapSnapshot
+{
+	std::string		name;
+	std::string		bgMusic;
+	std::string		tilesetPath;
+	std::string		edgeExitDestination;
+	Point_2d		edgeExitPosition;
+	GameField		field;
+	LevelEncoding	levelEncoding;
+	bool			showTitlePlaque;
+	bool			edgeExit;
+};
+
 /**
  * \class Map
  * \brief Implements a basic 2D tile map.
  * 
  * \note	Map handles updates and drawing of any Entity objects
  *			pushed into it.
+ * 
+ * \note	Constructing a Map doesn't touch the Renderer or OpenGL so maps can
+ *			be loaded on a worker thread. viewport() has to be set before the
+ *			Map is drawn.
  */
 class Map
 {
 public:
 
-	Map(const std::string& mapPath);
+	Map(const std::string& mapPath, LoadProgress* progress = nullptr);
 	Map(const std::string& name, const std::string& tsetPath, int width, int height);
+	Map(Map&& map);
 
 	~Map();
 
@@ -45,15 +86,26 @@ public:
 
 	Point_2d getGridCoords(const Point_2d& _pt) const;
 
-	Cell& getCell(const Point_2d& _pt);
-	Cell& getCellByGridCoords(const Point_2d& grid);
-	Cell& getCellByGridCoords(int x, int y);
+	Cell getCell(const Point_2d& _pt);
+	Cell getCellByGridCoords(const Point_2d& grid);
+	Cell getCellByGridCoords(int x, int y);
 
 	Tileset& tileset() { return mTileset; }
 
+	const LinkTable& links() const { return mField.links(); }
+
 	void save(const std::string& filePath);
 
+	MapSnapshot snapshot() const;
+	static bool save(const MapSnapshot& snapshot, const std::string& filePath);
+
+	const StringList& loadErrors() const { return mLoadErrors; }
+
+	LevelEncoding levelEncoding() const { return mLevelEncoding; }
+	void levelEncoding(LevelEncoding encoding) { mLevelEncoding = encoding; }
+
 	void dump(const std::string& filePath);
+	static bool dump(const MapSnapshot& snapshot, const Tileset& tileset, const std::string& filePath);
 
 	void viewport(const Rectangle_2d& _r);
 	const Rectangle_2d viewport() const { return mViewport; }
@@ -90,7 +142,9 @@ protected:
 	void showLinks(bool show);
 
 	GameField& field() { return mField; }
-	void field(const GameField& field) { mField = field; }
+	void field(const GameField& field) { mField = field; invalidateBatches(); }
+
+	size_t batchBytes() const;
 
 	Rectangle_2d injectMousePosition(const Point_2d& mouseCoords);
 
@@ -98,22 +152,51 @@ private:
 
 	typedef std::vector<Entity*>	EntityPtrList;
 
+	/**
+	 * Cached geometry of a single chunk of the GameField.
+	 */
+	struct ChunkBatch
+	{
+		ChunkBatch(): revision(0), lastFrame(0), built(false) {}
+
+		TileBatch		below;			/**< Base, base detail and detail layers. Drawn below entities. */
+		TileBatch		above;			/**< Foreground layer, collision and links. Drawn above entities. */
+
+		unsigned int	revision;		/**< GameField revision of the chunk when the batch was built. */
+		unsigned int	lastFrame;		/**< Last frame the batch was drawn. */
+		bool			built;			/**< Flag indicating that the batch holds valid geometry. */
+	};
+
+	typedef std::unordered_map<int, ChunkBatch>	ChunkBatchTable;
+
 	Map();
 
 	void load(const std::string& filepath);
+	void loadXml(const std::string& filepath);
+	void loadBinary(const std::string& filepath);
+
+	static bool writeXml(const MapSnapshot& snapshot, XmlWriter& writer);
+	static std::string serializeBinary(const MapSnapshot& snapshot);
 
 	void parseProperties(TiXmlNode* node);
 	void parseTilesets(TiXmlNode* node);
-	void parseLevels(TiXmlNode* node);
+	void parseLevels(const char* begin, const char* end);
 	void parseObjects(TiXmlNode* node);
 	void parseLinks(TiXmlNode* node);
 
+	void loadError(const std::string& message);
+
 	void validateCameraPosition();
 
 	int gridLocation(int point, int cameraPoint, int tileDimension, int viewportDimension) const;
 
 	void updateCamera();
 
+	ChunkBatch& chunkBatch(int chunkX, int chunkY);
+	void buildChunkBatch(ChunkBatch& batch, int chunkX, int chunkY);
+	void invalidateBatches();
+	void trimBatches();
+
 	std::string		mName;
 	std::string		mMessage;
 	std::string		mBgMusic;
@@ -132,6 +215,15 @@ private:
 
 	EntityPtrList	mEntityList;
 
+	ChunkBatchTable	mChunkBatches;			/**< Cached geometry of recently visible chunks keyed by chunk coordinates. */
+	unsigned int	mFrame;					/**< Number of frames drawn. Used to evict batches that are no longer visible. */
+
+	LevelEncoding	mLevelEncoding;			/**< Encoding used for the levels section when saving as XML. */
+
+	StringList		mLoadErrors;			/**< Problems found while loading the map. Empty if it loaded cleanly. */
+
+	LoadProgress*	mProgress;				/**< Progress of the load in progress, if anyone is interested. */
+
 	bool			mDrawBg;				/**< Flag indicating that the background layer should be drawn. */
 	bool			mDrawBgDetail;			/**< Flag indicating that the background detail layer should be drawn. */
 	bool			mDrawDetail;			/**< Flag indicating that the detail layer should be drawn. */
@@ -0,0 +1,484 @@
+#include "Map.h"
+#include "MapIndex.h"
+
+#include "../MappedFile.h"
+#include "../TraceRecorder.h"
+
+#include "physfs.h"
+
+#include <cstring>
+
+using namespace std;
+
+/**
+ * Binary map format
+ * 
+ * Everything is stored in the byte order of the machine that wrote the
+ * file, which is little-endian on every platform the editor builds for,
+ * and every section starts on a four byte boundary.
+ * 
+ *	MapHeader
+ *	Strings			Map name, background music, tileset path and edge exit
+ *					destination, each as a 32-bit length followed by the bytes.
+ *	Chunk masks		One byte per chunk in row-major order. Bits 0 - 3 flag
+ *					the tile layers that are stored, bit 4 the collision mask.
+ *	Chunk data		For every chunk, the flagged layers as CHUNK_AREA 16-bit
+ *					indices each followed by COLLISION_BYTES of collision
+ *					flags if flagged. Identical to the GameField layout.
+ *	Links			For every link its X, Y, destination X and destination Y
+ *					as 32-bit integers followed by the destination map name.
+ */
+
+const unsigned int	MAP_BINARY_VERSION		= 1;
+const std::string	MAP_BINARY_EXTENSION	= ".lmb";
+
+const char			MAP_BINARY_MAGIC[4]		= { 'L', 'L', 'M', 'B' };
+
+const unsigned int	FLAG_TITLE_PLAQUE		= 1 << 0;
+const unsigned int	FLAG_EDGE_EXIT			= 1 << 1;
+
+const unsigned char	MASK_COLLISION			= 1 << Cell::LAYER_COUNT;
+
+
+/**
+ * Fixed size header at the start of every binary map.
+ */
+struct MapHeader
+{
+	char			magic[4];
+	unsigned int	version;
+
+	int				width;
+	int				height;
+	int				tileWidth;
+	int				tileHeight;
+	int				chunkSize;
+
+	unsigned int	flags;
+
+	int				edgeExitX;
+	int				edgeExitY;
+
+	unsigned int	chunkCount;
+	unsigned int	linkCount;
+};
+
+
+/**
+ * Bounds checked cursor over a block of memory.
+ */
+class BinaryReader
+{
+public:
+	BinaryReader(const unsigned char* data, size_t size): mPosition(data), mEnd(data + size) {}
+
+	const unsigned char* take(size_t bytes)
+	{
+		if (static_cast<size_t>(mEnd - mPosition) < bytes)
+			return nullptr;
+
+		const unsigned char* _p = mPosition;
+		mPosition += (bytes + 3) & ~static_cast<size_t>(3);
+		if (mPosition > mEnd)
+			mPosition = mEnd;
+
+		return _p;
+	}
+
+	bool read(void* out, size_t bytes)
+	{
+		const unsigned char* _p = take(bytes);
+		if (!_p)
+			return false;
+
+		memcpy(out, _p, bytes);
+		return true;
+	}
+
+	bool read(string& out)
+	{
+		unsigned int length = 0;
+		if (!read(&length, sizeof(length)))
+			return false;
+
+		const unsigned char* _p = take(length);
+		if (!_p)
+			return false;
+
+		out.assign(reinterpret_cast<const char*>(_p), length);
+		return true;
+	}
+
+	size_t remaining() const { return static_cast<size_t>(mEnd - mPosition); }
+
+private:
+	const unsigned char*	mPosition;
+	const unsigned char*	mEnd;
+};
+
+
+/**
+ * Appends data to a buffer keeping every write four byte aligned.
+ */
+class BinaryWriter
+{
+public:
+	explicit BinaryWriter(string& buffer): mBuffer(buffer) {}
+
+	void write(const void* data, size_t bytes)
+	{
+		mBuffer.append(static_cast<const char*>(data), bytes);
+		mBuffer.append((4 - (bytes & 3)) & 3, '\0');
+	}
+
+	void write(const string& str)
+	{
+		unsigned int length = static_cast<unsigned int>(str.size());
+		write(&length, sizeof(length));
+		write(str.data(), str.size());
+	}
+
+private:
+	string&		mBuffer;
+};
+
+
+/**
+ * Gets the native path of a file within the NAS2D Filesystem. Returns an
+ * empty string if the file doesn't live in a plain directory.
+ */
+string nativePath(const string& path)
+{
+	const char* dir = PHYSFS_getRealDir(path.c_str());
+	if (!dir)
+		return "";
+
+	string nativePath = string(dir) + PHYSFS_getDirSeparator() + path;
+	for (size_t i = 0; i < nativePath.size(); i++)
+	{
+		if (nativePath[i] == '/')
+			nativePath[i] = PHYSFS_getDirSeparator()[0];
+	}
+
+	return nativePath;
+}
+
+
+/**
+ * Gets whether a path names a binary map.
+ */
+bool isBinaryMapPath(const std::string& path)
+{
+	return path.size() > MAP_BINARY_EXTENSION.size() && toLowercase(path.substr(path.size() - MAP_BINARY_EXTENSION.size())) == MAP_BINARY_EXTENSION;
+}
+
+
+/**
+ * Gets the format version of a binary map without loading it.
+ * 
+ * \return	Version of the map or 0 if the file isn't a binary map.
+ */
+unsigned int binaryMapVersion(const std::string& path)
+{
+	MappedFile file(nativePath(path));
+	if (!file.opened())
+		return 0;
+
+	MapHeader header;
+	BinaryReader reader(file.data(), file.size());
+	if (!reader.read(&header, sizeof(header)) || memcmp(header.magic, MAP_BINARY_MAGIC, sizeof(MAP_BINARY_MAGIC)) != 0)
+		return 0;
+
+	return header.version;
+}
+
+
+/**
+ * Reads the header of a binary map. Chunk data is skipped over without
+ * being touched.
+ */
+void MapIndex::readBinaryHeader(const unsigned char* data, size_t size, Entry& entry)
+{
+	MapHeader header;
+	BinaryReader reader(data, size);
+	if (!reader.read(&header, sizeof(header)) || memcmp(header.magic, MAP_BINARY_MAGIC, sizeof(MAP_BINARY_MAGIC)) != 0)
+		return;
+
+	entry.valid = true;
+	entry.binary = true;
+	entry.version = std::to_string(header.version);
+
+	// Anything past the header may be laid out differently in other versions.
+	if (header.version != MAP_BINARY_VERSION)
+		return;
+
+	entry.width = header.width;
+	entry.height = header.height;
+
+	string bgMusic, edgeExitDestination;
+	if (!reader.read(entry.name) || !reader.read(bgMusic) || !reader.read(entry.tileset) || !reader.read(edgeExitDestination))
+		return;
+
+	if (header.flags & FLAG_EDGE_EXIT)
+		addLink(entry, edgeExitDestination);
+
+	const unsigned char* masks = reader.take(header.chunkCount);
+	if (!masks)
+		return;
+
+	for (unsigned int chunk = 0; chunk < header.chunkCount; chunk++)
+	{
+		for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+		{
+			if ((masks[chunk] & (1 << layer)) && !reader.take(GameField::CHUNK_AREA * sizeof(GameField::TileIndex)))
+				return;
+		}
+
+		if ((masks[chunk] & MASK_COLLISION) && !reader.take(GameField::COLLISION_BYTES))
+			return;
+	}
+
+	for (unsigned int i = 0; i < header.linkCount; i++)
+	{
+		int link[4];
+		string destination;
+		if (!reader.read(link, sizeof(link)) || !reader.read(destination))
+			return;
+
+		addLink(entry, destination);
+	}
+}
+
+
+/**
+ * Loads a binary map. The file is memory mapped and chunk data is copied
+ * straight into the GameField.
+ * 
+ * \note	Falls back to reading the whole file through the NAS2D Filesystem
+ *			if it can't be mapped, e.g. when it's inside an archive.
+ */
+void Map::loadBinary(const std::string& filepath)
+{
+	TraceScope trace("Map::loadBinary", "map");
+
+	MappedFile mappedFile(nativePath(filepath));
+	File file;
+
+	const unsigned char* data = mappedFile.data();
+	size_t size = mappedFile.size();
+
+	if (!mappedFile.opened())
+	{
+		file = Utility<Filesystem>::get().open(filepath);
+		data = reinterpret_cast<const unsigned char*>(file.raw_bytes());
+		size = static_cast<size_t>(file.size());
+	}
+
+	BinaryReader reader(data, size);
+
+	MapHeader header;
+	if (!reader.read(&header, sizeof(header)) || memcmp(header.magic, MAP_BINARY_MAGIC, sizeof(MAP_BINARY_MAGIC)) != 0)
+	{
+		loadError("'" + filepath + "' is not a binary map file.");
+		return;
+	}
+
+	if (header.version != MAP_BINARY_VERSION)
+	{
+		loadError("Map '" + filepath + "' is version mismatched.");
+		return;
+	}
+
+	if (header.chunkSize != GameField::CHUNK_SIZE || header.width < 0 || header.height < 0)
+	{
+		loadError("Malformed map file '" + filepath + "'.");
+		return;
+	}
+
+	if (header.tileWidth != CELL_DIMENSIONS.w() || header.tileHeight != CELL_DIMENSIONS.h())
+		loadError("Tile sizes other than " + to_string(CELL_DIMENSIONS.w()) + "x" + to_string(CELL_DIMENSIONS.h()) + " pixels not supported.");
+
+	string tsetpath;
+	if (!reader.read(mName) || !reader.read(mBgMusic) || !reader.read(tsetpath) || !reader.read(mEdgeExitDestination))
+	{
+		loadError("Malformed map file '" + filepath + "'.");
+		return;
+	}
+
+	mShowTitlePlaque = (header.flags & FLAG_TITLE_PLAQUE) != 0;
+	mEdgeExit = (header.flags & FLAG_EDGE_EXIT) != 0;
+	mEdgeExitPosition(header.edgeExitX, header.edgeExitY);
+
+	if (!Utility<Filesystem>::get().exists(tsetpath))
+		throw Exception(0, "Missing TileSet", "Referened TileSet missing: " + tsetpath);
+
+	// Check the dimensions against what's actually in the file before
+	// allocating anything for them. Every chunk has at least its mask byte
+	// and every link at least its coordinates and the destination length.
+	const unsigned long long chunksWide = (static_cast<unsigned long long>(header.width) + GameField::CHUNK_SIZE - 1) / GameField::CHUNK_SIZE;
+	const unsigned long long chunksHigh = (static_cast<unsigned long long>(header.height) + GameField::CHUNK_SIZE - 1) / GameField::CHUNK_SIZE;
+	const unsigned long long minimumSize = static_cast<unsigned long long>(header.chunkCount) + static_cast<unsigned long long>(header.linkCount) * (4 * sizeof(int) + sizeof(unsigned int));
+
+	if (chunksWide * chunksHigh != header.chunkCount || minimumSize > reader.remaining())
+	{
+		loadError("Malformed map file '" + filepath + "'.");
+		return;
+	}
+
+	if (mProgress)
+		mProgress->stage(LoadProgress::STAGE_READING);
+
+	mField = GameField(header.width, header.height);
+	invalidateBatches();
+
+	const unsigned char* masks = reader.take(header.chunkCount);
+	if (!masks)
+	{
+		loadError("Malformed map file '" + filepath + "'.");
+		return;
+	}
+
+	for (unsigned int chunk = 0; chunk < header.chunkCount; chunk++)
+	{
+		if (mProgress && (chunk & 63) == 0)
+		{
+			if (mProgress->cancelled())
+			{
+				loadError("Loading cancelled.");
+				return;
+			}
+
+			mProgress->progress(static_cast<float>(chunk) / header.chunkCount);
+		}
+
+		for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+		{
+			if (!(masks[chunk] & (1 << layer)))
+				continue;
+
+			const unsigned char* layerData = reader.take(GameField::CHUNK_AREA * sizeof(GameField::TileIndex));
+			if (!layerData)
+			{
+				loadError("Malformed map file '" + filepath + "'.");
+				return;
+			}
+
+			mField.chunkLayer(chunk, static_cast<Cell::TileLayer>(layer), reinterpret_cast<const GameField::TileIndex*>(layerData));
+		}
+
+		if (masks[chunk] & MASK_COLLISION)
+		{
+			const unsigned char* collision = reader.take(GameField::COLLISION_BYTES);
+			if (!collision)
+			{
+				loadError("Malformed map file '" + filepath + "'.");
+				return;
+			}
+
+			mField.chunkCollision(chunk, collision);
+		}
+	}
+
+	for (unsigned int i = 0; i < header.linkCount; i++)
+	{
+		int link[4];
+		string destination;
+		if (!reader.read(link, sizeof(link)) || !reader.read(destination))
+		{
+			loadError("Malformed map file '" + filepath + "'.");
+			return;
+		}
+
+		if (link[0] < 0 || link[0] >= mField.width() || link[1] < 0 || link[1] >= mField.height())
+		{
+			loadError("WARNING: Link " + to_string(i) + " is outside of the map. Link will be ignored.");
+			continue;
+		}
+
+		mField.link(link[0], link[1], destination, Point_2d(link[2], link[3]));
+	}
+
+	if (mProgress)
+	{
+		if (mProgress->cancelled())
+		{
+			loadError("Loading cancelled.");
+			return;
+		}
+
+		mProgress->stage(LoadProgress::STAGE_TILESET);
+	}
+
+	mTileset = Tileset(tsetpath, CELL_DIMENSIONS.w(), CELL_DIMENSIONS.h(), mProgress);
+}
+
+
+/**
+ * Serializes a map snapshot in the binary format.
+ */
+std::string Map::serializeBinary(const MapSnapshot& snapshot)
+{
+	TraceScope trace("Map::serializeBinary", "map");
+
+	string buffer;
+	BinaryWriter writer(buffer);
+
+	MapHeader header;
+	memcpy(header.magic, MAP_BINARY_MAGIC, sizeof(MAP_BINARY_MAGIC));
+	header.version = MAP_BINARY_VERSION;
+	header.width = snapshot.field.width();
+	header.height = snapshot.field.height();
+	header.tileWidth = CELL_DIMENSIONS.w();
+	header.tileHeight = CELL_DIMENSIONS.h();
+	header.chunkSize = GameField::CHUNK_SIZE;
+	header.flags = (snapshot.showTitlePlaque ? FLAG_TITLE_PLAQUE : 0) | (snapshot.edgeExit ? FLAG_EDGE_EXIT : 0);
+	header.edgeExitX = snapshot.edgeExitPosition.x();
+	header.edgeExitY = snapshot.edgeExitPosition.y();
+	header.chunkCount = static_cast<unsigned int>(snapshot.field.chunksWide() * snapshot.field.chunksHigh());
+	header.linkCount = static_cast<unsigned int>(snapshot.field.links().size());
+	writer.write(&header, sizeof(header));
+
+	writer.write(snapshot.name);
+	writer.write(snapshot.bgMusic);
+	writer.write(snapshot.tilesetPath);
+	writer.write(snapshot.edgeExitDestination);
+
+	vector<unsigned char> masks(header.chunkCount, 0);
+	for (unsigned int chunk = 0; chunk < header.chunkCount; chunk++)
+	{
+		for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+		{
+			if (snapshot.field.chunkLayer(chunk, static_cast<Cell::TileLayer>(layer)))
+				masks[chunk] |= 1 << layer;
+		}
+
+		if (snapshot.field.chunkCollision(chunk))
+			masks[chunk] |= MASK_COLLISION;
+	}
+	writer.write(masks.data(), masks.size());
+
+	for (unsigned int chunk = 0; chunk < header.chunkCount; chunk++)
+	{
+		for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+		{
+			const GameField::TileIndex* layerData = snapshot.field.chunkLayer(chunk, static_cast<Cell::TileLayer>(layer));
+			if (layerData)
+				writer.write(layerData, GameField::CHUNK_AREA * sizeof(GameField::TileIndex));
+		}
+
+		if (snapshot.field.chunkCollision(chunk))
+			writer.write(snapshot.field.chunkCollision(chunk), GameField::COLLISION_BYTES);
+	}
+
+	std::vector<const LinkTable::Link*> linkList = snapshot.field.links().sorted();
+	for (size_t i = 0; i < linkList.size(); i++)
+	{
+		const LinkTable::Link* _l = linkList[i];
+
+		int link[4] = { _l->x, _l->y, _l->position.x(), _l->position.y() };
+		writer.write(link, sizeof(link));
+		writer.write(snapshot.field.links().name(_l->destination));
+	}
+
+	return buffer;
+}
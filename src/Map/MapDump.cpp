@@ -0,0 +1,119 @@
+#include "Map.h"
+
+#include "../Common.h"
+#include "../PngWriter.h"
+#include "../ThreadPool.h"
+#include "../TraceRecorder.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+
+/**
+ * Draws one row of cells into an RGBA buffer that's one row of cells high.
+ */
+static void rasterizeRow(const GameField& field, const Tileset& tileset, int row, unsigned char* pixels, size_t pitch)
+{
+	const size_t cellBytes = static_cast<size_t>(tileset.width()) * 4;
+
+	for (int col = 0; col < field.width(); )
+	{
+		const GameField::TileIndex* spans[Cell::LAYER_COUNT];
+		for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+			spans[layer] = field.span(static_cast<Cell::TileLayer>(layer), col, row);
+
+		int count = std::min(GameField::spanLength(col), field.width() - col);
+		for (int i = 0; i < count; i++, col++)
+		{
+			// Anything beneath the topmost opaque tile is never seen so start there.
+			int firstLayer = 0;
+			for (int layer = Cell::LAYER_COUNT - 1; layer > 0; layer--)
+			{
+				if (tileset.opacity(spans[layer][i]) == Tileset::TILE_OPAQUE)
+				{
+					firstLayer = layer;
+					break;
+				}
+			}
+
+			for (int layer = firstLayer; layer < Cell::LAYER_COUNT; layer++)
+				tileset.drawTileToBuffer(spans[layer][i], pixels + col * cellBytes, pitch);
+		}
+	}
+}
+
+
+/**
+ * Renders the whole map, all four layers, to a PNG file.
+ */
+void Map::dump(const std::string& filePath)
+{
+	if (!dump(snapshot(), mTileset, filePath))
+		cout << "Unable to dump map to '" << filePath << "'." << endl;
+}
+
+
+/**
+ * Renders a map snapshot, all four layers, to a PNG file.
+ * 
+ * The image is drawn on the CPU from the decoded tileset pixels one row
+ * of cells at a time. Rows are drawn and compressed in parallel and
+ * streamed to the file in order so only as many rows as there are worker
+ * threads are ever held in memory, regardless of how large the map is.
+ * 
+ * \note	Doesn't touch the Map, the Renderer or OpenGL so it's safe to
+ *			call from a worker thread. The tileset must not change while
+ *			the map is being dumped.
+ */
+bool Map::dump(const MapSnapshot& snapshot, const Tileset& tileset, const std::string& filePath)
+{
+	TraceScope trace("Map::dump", "map");
+
+	const GameField& field = snapshot.field;
+
+	const int width = field.width() * tileset.width();
+	const int height = field.height() * tileset.height();
+	if (width <= 0 || height <= 0)
+		return false;
+
+	const size_t pitch = static_cast<size_t>(width) * 4;
+
+	ThreadPool pool;
+
+	return writeFileAtomic(filePath, [&](std::ostream& stream)
+	{
+		PngWriter png(stream, width, height);
+
+		vector<PngWriter::Band> bands(pool.size());
+
+		for (int first = 0; first < field.height(); first += static_cast<int>(bands.size()))
+		{
+			int count = std::min(static_cast<int>(bands.size()), field.height() - first);
+
+			for (int i = 0; i < count; i++)
+			{
+				int row = first + i;
+				PngWriter::Band* band = &bands[i];
+
+				pool.enqueue([&field, &tileset, row, band, pitch, width]
+				{
+					vector<unsigned char> pixels(pitch * tileset.height(), 0);
+					rasterizeRow(field, tileset, row, &pixels[0], pitch);
+					PngWriter::compress(&pixels[0], pitch, width, tileset.height(), row == field.height() - 1, *band);
+				});
+			}
+
+			pool.wait();
+
+			for (int i = 0; i < count; i++)
+			{
+				if (!png.write(bands[i]))
+					return false;
+			}
+		}
+
+		return png.finish();
+	});
+}
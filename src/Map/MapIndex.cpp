@@ -0,0 +1,401 @@
+#include "MapIndex.h"
+
+#include "Map.h"
+
+#include "../MappedFile.h"
+#include "../ThreadPool.h"
+#include "../XmlPullReader.h"
+
+#include "physfs.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+const std::string	MAP_INDEX_MAGIC		= "LLMI";
+const int			MAP_INDEX_VERSION	= 1;
+
+
+/**
+ * Finds the last occurrence of a string within a block of memory. Searches
+ * backwards so only the tail of a memory mapped file is paged in.
+ * 
+ * \return	Pointer to the occurrence or \c end if there is none.
+ */
+static const char* findLast(const char* begin, const char* end, const char* str)
+{
+	size_t length = strlen(str);
+	if (static_cast<size_t>(end - begin) < length)
+		return end;
+
+	for (const char* _p = end - length; _p >= begin; _p--)
+	{
+		if (memcmp(_p, str, length) == 0)
+			return _p;
+	}
+
+	return end;
+}
+
+
+/**
+ * Gets the value of an attribute as a string with its entities decoded.
+ */
+static string attributeString(const XmlPullReader::Attribute& attribute)
+{
+	return XmlPullReader::decode(attribute.value, attribute.valueLength);
+}
+
+
+/**
+ * Strips the characters the index file uses as separators.
+ */
+static string sanitize(string str)
+{
+	for (size_t i = 0; i < str.size(); i++)
+	{
+		if (str[i] == '\t' || str[i] == '\n' || str[i] == '\r')
+			str[i] = ' ';
+	}
+
+	return str;
+}
+
+
+/**
+ * Gets whether this version of the editor can load the map.
+ */
+bool MapIndex::Entry::compatible() const
+{
+	if (!valid)
+		return false;
+
+	if (binary)
+		return version == std::to_string(MAP_BINARY_VERSION);
+
+	return version == MAP_DRIVER_VERSION;
+}
+
+
+/**
+ * C'tor
+ */
+MapIndex::MapIndex(): mDirty(false)
+{}
+
+
+/**
+ * Loads a previously saved index.
+ * 
+ * \return	False if there is no index or it can't be read. The index is left
+ *			empty and every file is read on the next refresh().
+ */
+bool MapIndex::load(const std::string& path)
+{
+	mEntries.clear();
+	mDirty = false;
+
+	if (!Utility<Filesystem>::get().exists(path))
+		return false;
+
+	File file = Utility<Filesystem>::get().open(path);
+	istringstream stream(file.bytes());
+
+	string line;
+	getline(stream, line);
+	if (line != MAP_INDEX_MAGIC + " " + std::to_string(MAP_INDEX_VERSION))
+	{
+		cout << "Map index '" << path << "' is version mismatched and will be rebuilt." << endl;
+		return false;
+	}
+
+	while (getline(stream, line))
+	{
+		vector<string> fields;
+		istringstream fieldStream(line);
+		string field;
+		while (getline(fieldStream, field, '\t'))
+			fields.push_back(field);
+
+		if (fields.size() < 11)
+			continue;
+
+		Entry& entry = mEntries[fields[0]];
+		entry.modified = strtoll(fields[1].c_str(), nullptr, 10);
+		entry.size = strtoll(fields[2].c_str(), nullptr, 10);
+		entry.valid = fields[3] == "1";
+		entry.binary = fields[4] == "1";
+		entry.version = fields[5];
+		entry.name = fields[6];
+		entry.tileset = fields[7];
+		entry.width = atoi(fields[8].c_str());
+		entry.height = atoi(fields[9].c_str());
+		entry.links.assign(fields.begin() + 11, fields.end());
+	}
+
+	return true;
+}
+
+
+/**
+ * Writes the index out if anything changed since it was loaded or saved.
+ */
+bool MapIndex::save(const std::string& path)
+{
+	if (!mDirty)
+		return true;
+
+	stringstream stream;
+	stream << MAP_INDEX_MAGIC << " " << MAP_INDEX_VERSION << "\n";
+
+	for (EntryTable::const_iterator it = mEntries.begin(); it != mEntries.end(); ++it)
+	{
+		const Entry& entry = it->second;
+
+		stream << sanitize(it->first) << "\t" << entry.modified << "\t" << entry.size << "\t";
+		stream << (entry.valid ? 1 : 0) << "\t" << (entry.binary ? 1 : 0) << "\t";
+		stream << sanitize(entry.version) << "\t" << sanitize(entry.name) << "\t" << sanitize(entry.tileset) << "\t";
+		stream << entry.width << "\t" << entry.height << "\t" << entry.links.size();
+
+		for (size_t i = 0; i < entry.links.size(); i++)
+			stream << "\t" << sanitize(entry.links[i]);
+
+		stream << "\n";
+	}
+
+	if (!Utility<Filesystem>::get().write(File(stream.str(), path)))
+		return false;
+
+	mDirty = false;
+	return true;
+}
+
+
+/**
+ * Brings the index up to date with the files in a directory. Only files
+ * that are new or changed are read, spread across a thread pool. Entries of
+ * files that aren't in \c files anymore are dropped.
+ * 
+ * \param	directory	Directory the files are in, including the trailing separator.
+ * \param	files		Names of the files within \c directory.
+ * \param	pool		Thread pool to read the files with.
+ * 
+ * \return	Number of files that were read.
+ */
+size_t MapIndex::refresh(const std::string& directory, const std::vector<std::string>& files, ThreadPool& pool)
+{
+	vector<Entry> results(files.size());
+	vector<char> reread(files.size(), 0);	// Not vector<bool>, workers write to it concurrently.
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		const Entry* cached = find(files[i]);
+		string path = directory + files[i];
+
+		pool.enqueue([&results, &reread, i, cached, path]
+		{
+			Entry& entry = results[i];
+
+			long long modified = 0, size = 0;
+			stat(path, modified, size);
+
+			if (cached && cached->modified == modified && cached->size == size)
+			{
+				entry = *cached;
+				return;
+			}
+
+			entry.modified = modified;
+			entry.size = size;
+			readHeader(path, entry);
+
+			reread[i] = 1;
+		});
+	}
+
+	pool.wait();
+
+	EntryTable entries;
+	size_t count = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		entries[files[i]] = std::move(results[i]);
+		count += reread[i];
+	}
+
+	if (count > 0 || entries.size() != mEntries.size())
+		mDirty = true;
+
+	mEntries.swap(entries);
+
+	return count;
+}
+
+
+/**
+ * Gets the entry of a file or nullptr if the file isn't indexed.
+ */
+const MapIndex::Entry* MapIndex::find(const std::string& file) const
+{
+	EntryTable::const_iterator it = mEntries.find(file);
+	if (it == mEntries.end())
+		return nullptr;
+
+	return &it->second;
+}
+
+
+/**
+ * Gets the modification time and size of a file without reading it.
+ */
+bool MapIndex::stat(const std::string& path, long long& modified, long long& size)
+{
+	modified = PHYSFS_getLastModTime(path.c_str());
+
+	PHYSFS_File* file = PHYSFS_openRead(path.c_str());
+	if (!file)
+		return false;
+
+	size = PHYSFS_fileLength(file);
+	PHYSFS_close(file);
+
+	return true;
+}
+
+
+/**
+ * Reads the header of a map file.
+ * 
+ * \note	Files are memory mapped so that only the pages holding the header
+ *			are read. Falls back to reading the whole file through the NAS2D
+ *			Filesystem if it can't be mapped.
+ */
+void MapIndex::readHeader(const std::string& path, Entry& entry)
+{
+	MappedFile mappedFile(nativePath(path));
+	File file;
+
+	const unsigned char* data = mappedFile.data();
+	size_t size = mappedFile.size();
+
+	if (!mappedFile.opened())
+	{
+		file = Utility<Filesystem>::get().open(path);
+		data = reinterpret_cast<const unsigned char*>(file.raw_bytes());
+		size = static_cast<size_t>(file.size());
+	}
+
+	if (!data || size == 0)
+		return;
+
+	if (isBinaryMapPath(path))
+		readBinaryHeader(data, size, entry);
+	else
+		readXmlHeader(reinterpret_cast<const char*>(data), size, entry);
+}
+
+
+/**
+ * Reads the header of an XML map. Everything before the levels section is
+ * pulled and, separately, the links section at the end of the file.
+ */
+void MapIndex::readXmlHeader(const char* data, size_t size, Entry& entry)
+{
+	const char* end = data + size;
+
+	const char* levels = XmlPullReader::find(data, end, "<levels");
+
+	XmlPullReader reader(data, levels ? levels : end);
+	XmlPullReader::Attribute attribute;
+
+	XmlPullReader::Token token;
+	while ((token = reader.next()) != XmlPullReader::TOKEN_EOF && token != XmlPullReader::TOKEN_ERROR)
+	{
+		if (token != XmlPullReader::TOKEN_START && token != XmlPullReader::TOKEN_EMPTY)
+			continue;
+
+		if (!entry.valid)
+		{
+			if (!reader.isName("map"))
+				return;
+
+			entry.valid = true;
+			while (reader.nextAttribute(attribute))
+			{
+				if (attribute.is("version"))
+					entry.version = attributeString(attribute);
+			}
+		}
+		else if (reader.isName("mapname"))
+		{
+			while (reader.nextAttribute(attribute))
+			{
+				if (attribute.is("name"))
+					entry.name = attributeString(attribute);
+			}
+		}
+		else if (reader.isName("mapsize"))
+		{
+			while (reader.nextAttribute(attribute))
+			{
+				if (attribute.is("width"))
+					entry.width = XmlPullReader::toInt(attribute.value, attribute.valueLength);
+				else if (attribute.is("height"))
+					entry.height = XmlPullReader::toInt(attribute.value, attribute.valueLength);
+			}
+		}
+		else if (reader.isName("tileset"))
+		{
+			while (reader.nextAttribute(attribute))
+			{
+				if (attribute.is("path"))
+					entry.tileset = attributeString(attribute);
+			}
+		}
+		else if (reader.isName("edge_exit"))
+		{
+			while (reader.nextAttribute(attribute))
+			{
+				if (attribute.is("destination"))
+					addLink(entry, attributeString(attribute));
+			}
+		}
+	}
+
+	if (!entry.valid)
+		return;
+
+	// Level data never contains a '<' so this can't match within it.
+	XmlPullReader links(findLast(data, end, "<links"), end);
+	while ((token = links.next()) != XmlPullReader::TOKEN_EOF && token != XmlPullReader::TOKEN_ERROR)
+	{
+		if ((token != XmlPullReader::TOKEN_START && token != XmlPullReader::TOKEN_EMPTY) || !links.isName("link"))
+			continue;
+
+		while (links.nextAttribute(attribute))
+		{
+			if (attribute.is("destination"))
+				addLink(entry, attributeString(attribute));
+		}
+	}
+}
+
+
+/**
+ * Adds a link destination to an entry unless it's already listed.
+ */
+void MapIndex::addLink(Entry& entry, const std::string& destination)
+{
+	if (destination.empty())
+		return;
+
+	for (size_t i = 0; i < entry.links.size(); i++)
+	{
+		if (entry.links[i] == destination)
+			return;
+	}
+
+	entry.links.push_back(destination);
+}
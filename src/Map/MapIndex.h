@@ -0,0 +1,81 @@
+#ifndef __MAP_INDEX__
+#define __MAP_INDEX__
+
+#include <map>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * \class	MapIndex
+ * \brief	Persistent cache of the headers of every map in a directory.
+ * 
+ * Each file is keyed by its name, modification time and size. refresh()
+ * only reads files that are new or have changed since they were last indexed
+ * and only reads as much of them as it needs to: the properties and tilesets
+ * sections and the links section of XML maps, the header, strings and links
+ * of binary maps. Level data is never parsed.
+ * 
+ * Files that turn out not to be maps are indexed as well so they aren't
+ * looked at again until they change.
+ */
+class MapIndex
+{
+public:
+
+	/**
+	 * Header of a single indexed file.
+	 */
+	struct Entry
+	{
+		Entry(): modified(0), size(0), valid(false), binary(false), width(0), height(0) {}
+
+		bool compatible() const;
+
+		long long					modified;	/**< Modification time of the file when it was indexed. */
+		long long					size;		/**< Size of the file in bytes when it was indexed. */
+
+		bool						valid;		/**< Whether the file is a map at all. */
+		bool						binary;		/**< Whether the file is a binary map. */
+
+		std::string					version;	/**< Driver version of an XML map or format version of a binary map. */
+		std::string					name;		/**< Name of the map. */
+		std::string					tileset;	/**< Path of the map's tileset. */
+
+		int							width;		/**< Width of the map in cells. */
+		int							height;		/**< Height of the map in cells. */
+
+		std::vector<std::string>	links;		/**< Destinations of the map's links and edge exit, without duplicates. */
+	};
+
+	typedef std::map<std::string, Entry> EntryTable;
+
+public:
+
+	MapIndex();
+
+	bool load(const std::string& path);
+	bool save(const std::string& path);
+
+	size_t refresh(const std::string& directory, const std::vector<std::string>& files, ThreadPool& pool);
+
+	const Entry* find(const std::string& file) const;
+	const EntryTable& entries() const { return mEntries; }
+
+private:
+
+	static bool stat(const std::string& path, long long& modified, long long& size);
+
+	static void readHeader(const std::string& path, Entry& entry);
+	static void readXmlHeader(const char* data, size_t size, Entry& entry);
+	static void readBinaryHeader(const unsigned char* data, size_t size, Entry& entry);
+
+	static void addLink(Entry& entry, const std::string& destination);
+
+	EntryTable		mEntries;		/**< Indexed files keyed by name within the indexed directory. */
+	bool			mDirty;			/**< Whether mEntries changed since it was loaded or saved. */
+};
+
+
+#endif
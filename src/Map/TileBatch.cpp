@@ -0,0 +1,177 @@
+#include "TileBatch.h"
+
+#include "../OpenGL.h"
+
+
+static void pushQuad(std::vector<float>& v, float x, float y, float w, float h)
+{
+	const float quad[] = { x, y, x + w, y, x + w, y + h, x, y, x + w, y + h, x, y + h };
+	v.insert(v.end(), quad, quad + 12);
+}
+
+
+static void pushColor(std::vector<unsigned char>& c, const Color_4ub& color, int vertices)
+{
+	for (int i = 0; i < vertices; i++)
+	{
+		c.push_back(color.red());
+		c.push_back(color.green());
+		c.push_back(color.blue());
+		c.push_back(color.alpha());
+	}
+}
+
+
+/**
+ * Removes all geometry from the batch. Keeps the allocated storage so
+ * that rebuilding a batch doesn't reallocate.
+ */
+void TileBatch::clear()
+{
+	for (size_t i = 0; i < mTileGroups.size(); i++)
+	{
+		mTileGroups[i].vertices.clear();
+		mTileGroups[i].texCoords.clear();
+	}
+
+	mFillVertices.clear();
+	mFillColors.clear();
+	mLineVertices.clear();
+	mLineColors.clear();
+}
+
+
+/**
+ * Gets whether the batch holds no geometry at all.
+ */
+bool TileBatch::empty() const
+{
+	for (size_t i = 0; i < mTileGroups.size(); i++)
+		if (!mTileGroups[i].vertices.empty())
+			return false;
+
+	return mFillVertices.empty() && mLineVertices.empty();
+}
+
+
+/**
+ * Adds a textured tile.
+ * 
+ * \param	layer	Layer the tile is on. Tiles of lower layers are drawn first.
+ * \param	page	Tileset page the tile is on.
+ * \param	uv		Normalized texture coordinates of the tile within its page.
+ */
+void TileBatch::addTile(int layer, int page, const Rectangle_2df& uv, float x, float y, float w, float h)
+{
+	// There are only ever a few groups and tiles tend to come in runs of the same one.
+	size_t i = mTileGroups.size();
+	while (i > 0 && (mTileGroups[i - 1].layer > layer || (mTileGroups[i - 1].layer == layer && mTileGroups[i - 1].page > page)))
+		--i;
+
+	if (i == 0 || mTileGroups[i - 1].layer != layer || mTileGroups[i - 1].page != page)
+		mTileGroups.insert(mTileGroups.begin() + i++, TileGroup(layer, page));
+
+	TileGroup& group = mTileGroups[i - 1];
+	pushQuad(group.vertices, x, y, w, h);
+	pushQuad(group.texCoords, uv.x(), uv.y(), uv.w(), uv.h());
+}
+
+
+/**
+ * Adds a filled box.
+ */
+void TileBatch::addBoxFilled(float x, float y, float w, float h, const Color_4ub& color)
+{
+	pushQuad(mFillVertices, x, y, w, h);
+	pushColor(mFillColors, color, 6);
+}
+
+
+/**
+ * Adds a box outline.
+ */
+void TileBatch::addBox(float x, float y, float w, float h, const Color_4ub& color)
+{
+	const float lines[] = { x, y, x + w, y, x + w, y, x + w, y + h, x + w, y + h, x, y + h, x, y + h, x, y };
+	mLineVertices.insert(mLineVertices.end(), lines, lines + 16);
+	pushColor(mLineColors, color, 8);
+}
+
+
+/**
+ * Draws all tiles in the batch with its origin at X, Y, binding the
+ * texture of each group's page of the tileset.
+ */
+void TileBatch::drawTiles(const Tileset& tileset, float x, float y) const
+{
+	glPushMatrix();
+	glTranslatef(x, y, 0.0f);
+
+	glColor4ub(255, 255, 255, 255);
+
+	for (size_t i = 0; i < mTileGroups.size(); i++)
+	{
+		const TileGroup& group = mTileGroups[i];
+		if (group.vertices.empty())
+			continue;
+
+		glBindTexture(GL_TEXTURE_2D, tileset.textureId(group.page));
+
+		glVertexPointer(2, GL_FLOAT, 0, &group.vertices[0]);
+		glTexCoordPointer(2, GL_FLOAT, 0, &group.texCoords[0]);
+		glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(group.vertices.size() / 2));
+	}
+
+	glPopMatrix();
+}
+
+
+/**
+ * Draws all filled boxes and outlines in the batch with its origin at X, Y.
+ */
+void TileBatch::drawOverlays(float x, float y) const
+{
+	if (mFillVertices.empty() && mLineVertices.empty())
+		return;
+
+	glPushMatrix();
+	glTranslatef(x, y, 0.0f);
+
+	glDisable(GL_TEXTURE_2D);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	if (!mFillVertices.empty())
+	{
+		glVertexPointer(2, GL_FLOAT, 0, &mFillVertices[0]);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, &mFillColors[0]);
+		glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(mFillVertices.size() / 2));
+	}
+
+	if (!mLineVertices.empty())
+	{
+		glVertexPointer(2, GL_FLOAT, 0, &mLineVertices[0]);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, &mLineColors[0]);
+		glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(mLineVertices.size() / 2));
+	}
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnable(GL_TEXTURE_2D);
+
+	glPopMatrix();
+}
+
+
+/**
+ * Gets the number of bytes of geometry the batch holds.
+ */
+size_t TileBatch::bytes() const
+{
+	size_t bytes = (mFillVertices.capacity() + mLineVertices.capacity()) * sizeof(float) + mFillColors.capacity() + mLineColors.capacity();
+
+	for (size_t i = 0; i < mTileGroups.size(); i++)
+		bytes += (mTileGroups[i].vertices.capacity() + mTileGroups[i].texCoords.capacity()) * sizeof(float);
+
+	return bytes;
+}
@@ -0,0 +1,74 @@
+#ifndef __TILE_BATCH__
+#define __TILE_BATCH__
+
+#include "NAS2D/NAS2D.h"
+
+#include "Tileset.h"
+
+#include <vector>
+
+using namespace NAS2D;
+
+/**
+ * \class TileBatch
+ * \brief Cached geometry for a group of tiles and overlay boxes.
+ * 
+ * Tiles are stored as textured triangles, filled boxes as colored triangles
+ * and box outlines as colored lines, all in batch-local coordinates. A batch
+ * is built once and then submitted with a handful of draw calls at any
+ * screen position until it's cleared and rebuilt.
+ * 
+ * Tiles are grouped by layer and by tileset page, one draw call per group.
+ * Groups are drawn in layer order. Tiles within a layer don't overlap, so
+ * the order of the pages within a layer doesn't matter.
+ * 
+ * \note	Submits geometry through OpenGL directly, the same way the NAS2D
+ *			renderer does internally, because the Renderer interface offers
+ *			no way to draw more than one quad per call.
+ */
+class TileBatch
+{
+public:
+
+	TileBatch() {}
+
+	void clear();
+
+	void addTile(int layer, int page, const Rectangle_2df& uv, float x, float y, float w, float h);
+	void addBoxFilled(float x, float y, float w, float h, const Color_4ub& color);
+	void addBox(float x, float y, float w, float h, const Color_4ub& color);
+
+	void drawTiles(const Tileset& tileset, float x, float y) const;
+	void drawOverlays(float x, float y) const;
+
+	bool empty() const;
+
+	size_t bytes() const;
+
+private:
+
+	/**
+	 * Tiles of one layer that are on the same tileset page.
+	 */
+	struct TileGroup
+	{
+		TileGroup(int _layer, int _page): layer(_layer), page(_page) {}
+
+		int					layer;			/**< Layer the tiles are on. */
+		int					page;			/**< Tileset page the tiles are on. */
+
+		std::vector<float>	vertices;		/**< Two floats per vertex, six vertices per tile. */
+		std::vector<float>	texCoords;		/**< Two floats per vertex. */
+	};
+
+	std::vector<TileGroup>		mTileGroups;		/**< Tile groups ordered by layer and page. Emptied groups are kept for their storage. */
+
+	std::vector<float>			mFillVertices;		/**< Two floats per vertex, six vertices per box. */
+	std::vector<unsigned char>	mFillColors;		/**< Four bytes per vertex. */
+
+	std::vector<float>			mLineVertices;		/**< Two floats per vertex, eight vertices per box. */
+	std::vector<unsigned char>	mLineColors;		/**< Four bytes per vertex. */
+};
+
+
+#endif
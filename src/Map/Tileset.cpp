@@ -1,21 +1,415 @@
 #include "Tileset.h"
 
+#include "LoadProgress.h"
+
+#include "../Common.h"
+#include "../ThreadPool.h"
+#include "../TraceRecorder.h"
+
 #include "NAS2D/NAS2D.h"
+#include "SDL2/SDL_image.h"
+
+#include "physfs.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TILESET_SSE2
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
 const Color_4ub COLOR_CLEAR(0, 0, 0, 0);
 
+const size_t MAX_UNUSED_TILESETS = 4;		/**< Number of tilesets no Map uses that are kept cached. */
+
+const std::string	TILESET_CACHE_EXTENSION	= ".tsc";
+
+const int			TILESET_PAGE_SIZE		= 1024;
+
+const unsigned int	PAGE_IDLE_FRAMES		= 600;		/**< Number of frames a page can go without being drawn before its texture is released. */
+
+const unsigned int	TILESET_CACHE_VERSION	= 1;
+const char			TILESET_CACHE_MAGIC[4]	= { 'L', 'T', 'S', 'C' };
+
+
+/**
+ * Fixed size header at the start of a tileset cache file. It's followed by
+ * the RGBA average color of every tile and then the opacity of every tile,
+ * one byte each.
+ */
+struct TilesetCacheHeader
+{
+	char			magic[4];
+	unsigned int	version;
+
+	unsigned int	hash;			/**< CRC-32 of the tileset image file the cache was made from. */
+
+	int				tileWidth;
+	int				tileHeight;
+	int				numTiles;
+};
+
+
+/**
+ * Process-wide cache of loaded tilesets.
+ */
+struct Tileset::Cache
+{
+	/**
+	 * A cached tileset.
+	 */
+	struct Entry
+	{
+		Entry(): modified(0), lastUsed(0) {}
+
+		long long		modified;		/**< Modification time of the image when it was loaded. */
+		unsigned int	lastUsed;		/**< Value of Cache::clock when the entry was last handed out. */
+		DataPtr			data;			/**< Tileset data. Unused when the cache holds the only reference. */
+	};
+
+	Cache(): clock(0) {}
+
+	std::mutex						mutex;		/**< Guards everything below. */
+	std::map<std::string, Entry>	entries;	/**< Cached tilesets keyed by path and tile size. */
+	std::vector<DataPtr>			released;	/**< Replaced entries waiting for trimCache() to let go of them. */
+	unsigned int					clock;		/**< Counter used to order entries by use. */
+};
+
+
+/**
+ * Gets the tileset cache.
+ */
+Tileset::Cache& Tileset::cache()
+{
+	static Cache tilesetCache;
+	return tilesetCache;
+}
+
+
+/**
+ * C'tor
+ * 
+ * Constructs an empty tileset.
+ */
+Tileset::Tileset():	mData(std::make_shared<Data>())
+{}
+
+
 /**
  * C'tor
+ * 
+ * Looks the tileset up in the cache and only loads it if it isn't cached
+ * or the image has been modified since it was.
+ */
+Tileset::Tileset(const string& path, int tileWidth, int tileHeight, LoadProgress* progress):	mData(load(path, tileWidth, tileHeight, progress))
+{}
+
+
+/**
+ * Gets a tileset from the cache or loads it.
+ * 
+ * Loading happens without holding the cache lock so two threads asking for
+ * the same tileset at the same time may both load it. Only one copy ends up
+ * cached.
+ * 
+ * \note	Doesn't touch OpenGL so it's safe to call from any thread.
+ */
+Tileset::DataPtr Tileset::load(const string& path, int tileWidth, int tileHeight, LoadProgress* progress)
+{
+	TraceScope trace("Tileset::load", "tileset");
+
+	const string key = path + "|" + std::to_string(tileWidth) + "x" + std::to_string(tileHeight);
+	const long long modified = PHYSFS_getLastModTime(path.c_str());
+
+	Cache& c = cache();
+
+	{
+		std::lock_guard<std::mutex> lock(c.mutex);
+
+		map<string, Cache::Entry>::iterator it = c.entries.find(key);
+		if(it != c.entries.end() && it->second.modified == modified)
+		{
+			it->second.lastUsed = ++c.clock;
+			return it->second.data;
+		}
+	}
+
+	std::shared_ptr<Data> data = std::make_shared<Data>();
+	data->path = path;
+	data->tileDimensions(tileWidth, tileHeight);
+	data->tileHalfDimensions(tileWidth / 2, tileHeight / 2);
+	data->tilesetDimensions(0, 0);
+
+	unsigned int hash = 0;
+	if(!decode(path, *data, hash))
+	{
+		cout << "Tileset image did not loaded properly." << endl;
+		return data;
+	}
+
+	data->tilesetDimensions.x(data->imageDimensions.x() / tileWidth);
+	data->tilesetDimensions.y(data->imageDimensions.y() / tileHeight);
+
+	setupPages(*data);
+
+	if(!readCache(path, hash, *data))
+	{
+		fillTileColorList(*data, progress);
+
+		// A cancelled load leaves the tile data incomplete.
+		if(progress && progress->cancelled())
+			return data;
+
+		writeCache(path, hash, *data);
+	}
+
+	std::lock_guard<std::mutex> lock(c.mutex);
+
+	Cache::Entry& entry = c.entries[key];
+	if(entry.data && entry.modified == modified)
+	{
+		entry.lastUsed = ++c.clock;
+		return entry.data;
+	}
+
+	// The replaced tileset may hold the last reference to a texture which
+	// has to be released on the thread that owns the OpenGL context.
+	if(entry.data)
+		c.released.push_back(entry.data);
+
+	entry.modified = modified;
+	entry.lastUsed = ++c.clock;
+	entry.data = data;
+
+	return entry.data;
+}
+
+
+/**
+ * Drops cached tilesets that no Map uses anymore, keeping the most
+ * recently used few around.
+ * 
+ * \note	Must be called from the thread that owns the OpenGL context.
+ */
+void Tileset::trimCache()
+{
+	vector<DataPtr> dropped;
+
+	{
+		Cache& c = cache();
+		std::lock_guard<std::mutex> lock(c.mutex);
+
+		dropped.swap(c.released);
+
+		vector<map<string, Cache::Entry>::iterator> unused;
+		for(map<string, Cache::Entry>::iterator it = c.entries.begin(); it != c.entries.end(); ++it)
+			if(it->second.data.use_count() == 1)
+				unused.push_back(it);
+
+		if(unused.size() <= MAX_UNUSED_TILESETS)
+			return;
+
+		sort(unused.begin(), unused.end(), [](const map<string, Cache::Entry>::iterator& a, const map<string, Cache::Entry>::iterator& b) { return a->second.lastUsed < b->second.lastUsed; });
+
+		for(size_t i = 0; i < unused.size() - MAX_UNUSED_TILESETS; i++)
+		{
+			dropped.push_back(unused[i]->second.data);
+			c.entries.erase(unused[i]);
+		}
+	}
+
+	// Textures are released here, outside of the lock.
+}
+
+
+/**
+ * Drops every cached tileset. Tilesets still in use stay alive until the
+ * last copy is gone.
+ * 
+ * \note	Must be called from the thread that owns the OpenGL context.
+ */
+void Tileset::clearCache()
+{
+	vector<DataPtr> dropped;
+
+	{
+		Cache& c = cache();
+		std::lock_guard<std::mutex> lock(c.mutex);
+
+		dropped.swap(c.released);
+		for(map<string, Cache::Entry>::iterator it = c.entries.begin(); it != c.entries.end(); ++it)
+			dropped.push_back(it->second.data);
+
+		c.entries.clear();
+	}
+}
+
+
+/**
+ * Decodes the tileset image into RGBA pixels.
+ * 
+ * \param	hash	Receives the CRC-32 of the image file.
+ * 
+ * \note	Doesn't touch OpenGL so it's safe to call from any thread.
+ */
+bool Tileset::decode(const string& path, Data& data, unsigned int& hash)
+{
+	TraceScope trace("Tileset::decode", "tileset");
+
+	File file = Utility<Filesystem>::get().open(path);
+	if(file.empty())
+		return false;
+
+	hash = static_cast<unsigned int>(crc32(0, reinterpret_cast<const Bytef*>(file.raw_bytes()), static_cast<uInt>(file.size())));
+
+	SDL_Surface* image = IMG_Load_RW(SDL_RWFromConstMem(file.raw_bytes(), file.size()), 1);
+	if(!image)
+		return false;
+
+	SDL_Surface* rgba = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(image);
+
+	if(!rgba)
+		return false;
+
+	data.imageDimensions(rgba->w, rgba->h);
+	data.pixels.resize(rgba->w * rgba->h * 4);
+
+	for(int y = 0; y < rgba->h; y++)
+		memcpy(&data.pixels[y * rgba->w * 4], static_cast<const unsigned char*>(rgba->pixels) + y * rgba->pitch, rgba->w * 4);
+
+	SDL_FreeSurface(rgba);
+
+	return true;
+}
+
+
+/**
+ * Lays out the pages of a tileset. Pages are as many whole tiles as fit in
+ * TILESET_PAGE_SIZE pixels in each direction, the ones on the right and
+ * bottom edges may be smaller.
+ */
+void Tileset::setupPages(Data& data)
+{
+	data.pageTiles(std::max(TILESET_PAGE_SIZE / data.tileDimensions.x(), 1), std::max(TILESET_PAGE_SIZE / data.tileDimensions.y(), 1));
+	data.pagesDimensions((data.tilesetDimensions.x() + data.pageTiles.x() - 1) / data.pageTiles.x(), (data.tilesetDimensions.y() + data.pageTiles.y() - 1) / data.pageTiles.y());
+	data.pages.resize(data.pagesDimensions.x() * data.pagesDimensions.y());
+}
+
+
+/**
+ * Gets the page an indexed tile is on.
+ * 
+ * \note	Does not check to see if the index is outside the bounds
+ *			of a tileset image.
+ */
+int Tileset::page(int index) const
+{
+	if(mData->pages.empty())
+		return 0;
+
+	int col = index % mData->tilesetDimensions.x();
+	int row = index / mData->tilesetDimensions.x();
+
+	return (row / mData->pageTiles.y()) * mData->pagesDimensions.x() + col / mData->pageTiles.x();
+}
+
+
+/**
+ * Gets the area of the tileset image a page covers.
+ */
+const Rectangle_2d Tileset::pageCoords(int page) const
+{
+	const Data& data = *mData;
+
+	int col = page % data.pagesDimensions.x();
+	int row = page / data.pagesDimensions.x();
+
+	int tilesWide = std::min(data.pageTiles.x(), data.tilesetDimensions.x() - col * data.pageTiles.x());
+	int tilesHigh = std::min(data.pageTiles.y(), data.tilesetDimensions.y() - row * data.pageTiles.y());
+
+	return Rectangle_2d(col * data.pageTiles.x() * data.tileDimensions.x(), row * data.pageTiles.y() * data.tileDimensions.y(), tilesWide * data.tileDimensions.x(), tilesHigh * data.tileDimensions.y());
+}
+
+
+/**
+ * Gets a page, creating its texture if it isn't resident, and marks it as
+ * used this frame.
+ * 
+ * \note	Must be called from the thread that owns the OpenGL context.
+ */
+Tileset::Page& Tileset::residentPage(int page) const
+{
+	Page& p = mData->pages[page];
+	p.lastUsed = mData->frame;
+
+	if(p.resident)
+		return p;
+
+	const Rectangle_2d rect = pageCoords(page);
+
+	if(rect.w() == mData->imageDimensions.x() && rect.h() == mData->imageDimensions.y())
+	{
+		p.image = Image(const_cast<unsigned char*>(&mData->pixels[0]), 4, rect.w(), rect.h());
+	}
+	else
+	{
+		const size_t rowBytes = static_cast<size_t>(rect.w()) * 4;
+
+		p.pixels.resize(rowBytes * rect.h());
+		for(int y = 0; y < rect.h(); y++)
+			memcpy(&p.pixels[y * rowBytes], &mData->pixels[((rect.y() + y) * mData->imageDimensions.x() + rect.x()) * 4], rowBytes);
+
+		p.image = Image(&p.pixels[0], 4, rect.w(), rect.h());
+	}
+
+	p.resident = true;
+	return p;
+}
+
+
+/**
+ * Gets the OpenGL texture of a page, creating it if needed.
+ * 
+ * \note	Must be called from the thread that owns the OpenGL context.
+ */
+unsigned int Tileset::textureId(int page) const
+{
+	if(page < 0 || page >= pageCount())
+		return 0;
+
+	return residentPage(page).image.texture_id();
+}
+
+
+/**
+ * Releases the textures of pages that haven't been drawn for a while.
+ * Call once per frame.
+ * 
+ * \note	Must be called from the thread that owns the OpenGL context.
  */
-Tileset::Tileset(const string& path, int tileWidth, int tileHeight):	mTileset(path),
-																		mTsetPath(path),
-																		mTileDimensions(tileWidth, tileHeight),
-																		mTileHalfDimensions(tileWidth / 2, tileHeight / 2),
-																		mTilesetDimensions(0, 0)
+void Tileset::trimPages() const
 {
-	init();
+	unsigned int frame = ++mData->frame;
+
+	for(size_t i = 0; i < mData->pages.size(); i++)
+	{
+		Page& p = mData->pages[i];
+		if(!p.resident || frame - p.lastUsed < PAGE_IDLE_FRAMES)
+			continue;
+
+		p.image = Image();
+		std::vector<unsigned char>().swap(p.pixels);
+		p.resident = false;
+	}
 }
 
 
@@ -26,12 +420,31 @@ Tileset::Tileset(const string& path, int tileWidth, int tileHeight):	mTileset(pa
  * \note	Does not check to see if the index is outside the bounds
  *			of a tileset image.
  */
-const Rectangle_2d Tileset::getTsetCoordsFromIndex(int index) const
+const Rectangle_2d Tileset::getTsetCoordsFromIndex(const Data& data, int index)
+{
+	int x = (index % data.tilesetDimensions.x()) * data.tileDimensions.x();
+	int y = (index / data.tilesetDimensions.x()) * data.tileDimensions.y();
+
+	return Rectangle_2d(x, y, data.tileDimensions.x(), data.tileDimensions.y());
+}
+
+
+/**
+ * Gets the normalized texture coordinates of an indexed tile within the
+ * texture of its page.
+ * 
+ * \note	Does not check to see if the index is outside the bounds
+ *			of a tileset image.
+ */
+Rectangle_2df Tileset::textureCoords(int index) const
 {
-	int x = (index % mTilesetDimensions.x()) * mTileDimensions.x();
-	int y = (index / mTilesetDimensions.x()) * mTileDimensions.y();
+	const Rectangle_2d rect = getTsetCoordsFromIndex(*mData, index);
+	const Rectangle_2d pageRect = pageCoords(page(index));
+
+	float w = static_cast<float>(pageRect.w());
+	float h = static_cast<float>(pageRect.h());
 
-	return Rectangle_2d(x, y, mTileDimensions.x(), mTileDimensions.y());
+	return Rectangle_2df((rect.x() - pageRect.x()) / w, (rect.y() - pageRect.y()) / h, rect.w() / w, rect.h() / h);
 }
 
 
@@ -43,18 +456,69 @@ const Rectangle_2d Tileset::getTsetCoordsFromIndex(int index) const
  */
 void Tileset::drawTile(int index, int x, int y)
 {
-	const Rectangle_2d rect = getTsetCoordsFromIndex(index);
-	Utility<Renderer>::get().drawSubImage(mTileset, x, y, rect.x(), rect.y(), rect.w(), rect.h());
+	if(mData->pages.empty())
+		return;
+
+	const int tilePage = page(index);
+	const Rectangle_2d rect = getTsetCoordsFromIndex(*mData, index);
+	const Rectangle_2d pageRect = pageCoords(tilePage);
+
+	Utility<Renderer>::get().drawSubImage(residentPage(tilePage).image, x, y, rect.x() - pageRect.x(), rect.y() - pageRect.y(), rect.w(), rect.h());
 }
 
 
 /**
- * Draws tiles to an Image instead of the screen.
+ * Draws an indexed tile into an RGBA buffer instead of the screen,
+ * blending it over what's already there by its alpha.
+ * 
+ * Works from the decoded tileset pixels so it's safe to call from any
+ * thread. Indices outside of the tileset are ignored.
+ * 
+ * \param	index	Tile index.
+ * \param	buffer	Pixel in the buffer the top left of the tile goes to.
+ * \param	pitch	Bytes from one row of the buffer to the next.
  */
-void Tileset::drawTileToImage(Image& img, int index, int x, int y)
+void Tileset::drawTileToBuffer(int index, unsigned char* buffer, size_t pitch) const
 {
-//	const Rectangle_2d rect = getTsetCoordsFromIndex(index);
-//	Utility<Renderer>::get().drawImageToImage(mTileset, rect, img, Point_2d(x, y));
+	TileOpacity tileOpacity = opacity(index);
+	if(tileOpacity == TILE_EMPTY || mData->pixels.empty())
+		return;
+
+	const Rectangle_2d rect = getTsetCoordsFromIndex(*mData, index);
+	const size_t rowBytes = static_cast<size_t>(rect.w()) * 4;
+
+	for(int y = 0; y < rect.h(); y++)
+	{
+		const unsigned char* src = &mData->pixels[((rect.y() + y) * mData->imageDimensions.x() + rect.x()) * 4];
+		unsigned char* dst = buffer + y * pitch;
+
+		if(tileOpacity == TILE_OPAQUE)
+		{
+			memcpy(dst, src, rowBytes);
+			continue;
+		}
+
+		for(size_t i = 0; i < rowBytes; i += 4)
+		{
+			unsigned int a = src[i + 3];
+			if(a == 0)
+				continue;
+
+			unsigned int da = dst[i + 3];
+			if(a == 255 || da == 0)
+			{
+				memcpy(dst + i, src + i, 4);
+				continue;
+			}
+
+			// Porter-Duff "over" with straight alpha.
+			unsigned int outA = a * 255 + da * (255 - a);		// Scaled by 255.
+			for(int c = 0; c < 3; c++)
+				dst[i + c] = static_cast<unsigned char>((src[i + c] * a * 255 + dst[i + c] * da * (255 - a) + outA / 2) / outA);
+
+			dst[i + 3] = static_cast<unsigned char>((outA + 127) / 255);
+		}
+	}
 }
 
 
@@ -66,7 +530,7 @@ void Tileset::drawTileColorPalette(int x, int y, int cell_size, int columns)
 	int col = 0;
 	for(int i = 0; i < numTiles(); i++)
 	{
-		Utility<Renderer>::get().drawBoxFilled(rect, mAverageTileColorsList[i].red(), mAverageTileColorsList[i].green(), mAverageTileColorsList[i].blue(), mAverageTileColorsList[i].alpha());
+		Utility<Renderer>::get().drawBoxFilled(rect, mData->averageColors[i].red(), mData->averageColors[i].green(), mData->averageColors[i].blue(), mData->averageColors[i].alpha());
 
 		col++;
 		
@@ -81,72 +545,278 @@ void Tileset::drawTileColorPalette(int x, int y, int cell_size, int columns)
 }
 
 
-/**
- * Performs basic processing on the base tileset image and gets
- * several internal variables ready for use.
- */
-void Tileset::init()
+const Color_4ub& Tileset::averageColor(int index)
 {
-	if(!mTileset.loaded())
-	{
-		cout << "Tileset image did not loaded properly." << endl;
-		return;
-	}
-
-	mTilesetDimensions.x(mTileset.width() / mTileDimensions.x());
-	mTilesetDimensions.y(mTileset.height() / mTileDimensions.y());
+	if(index < mData->averageColors.size())
+		return mData->averageColors[index];
 
-	fillTileColorList();
+	return COLOR_CLEAR;
 }
 
 
-const Color_4ub& Tileset::averageColor(int index)
+/**
+ * Gets how much of a tile's area is covered. Indices outside of the
+ * tileset are treated as empty.
+ */
+Tileset::TileOpacity Tileset::opacity(int index) const
 {
-	if(index < mAverageTileColorsList.size())
-		return mAverageTileColorsList[index];
+	if(index < 0 || index >= static_cast<int>(mData->opacities.size()))
+		return TILE_EMPTY;
 
-	return COLOR_CLEAR;
+	return mData->opacities[index];
 }
 
 
-void Tileset::fillTileColorList()
+/**
+ * Sums gathered over the pixels of a tile by analyzeTile().
+ */
+struct PixelTotals
 {
-	mAverageTileColorsList.resize(numTiles());
+	PixelTotals(): red(0), green(0), blue(0), weighted(0), opaque(0), clear(0) {}
 
-	for(int i = 0; i < numTiles(); i++)
+	unsigned int	red;		/**< Sum of the red channel of weighted pixels. */
+	unsigned int	green;		/**< Sum of the green channel of weighted pixels. */
+	unsigned int	blue;		/**< Sum of the blue channel of weighted pixels. */
+	unsigned int	weighted;	/**< Number of pixels with an alpha above 235. Only those count towards the average color. */
+	unsigned int	opaque;		/**< Number of fully opaque pixels. */
+	unsigned int	clear;		/**< Number of fully transparent pixels. */
+};
+
+
+/**
+ * Gathers the sums needed to classify a tile and get its average color.
+ * 
+ * Works on four RGBA pixels at a time with SSE2 where it's available.
+ * 
+ * \param	pixels	First pixel of the tile.
+ * \param	pitch	Bytes from one row of the image to the next.
+ */
+static void analyzeTile(const unsigned char* pixels, size_t pitch, int width, int height, PixelTotals& totals)
+{
+	for(int y = 0; y < height; y++)
 	{
-		const Rectangle_2d& rect = getTsetCoordsFromIndex(i);
-		int r = 0, g = 0, b = 0, a = 0;
-		int pixel_count = 0;
+		const unsigned char* row = pixels + y * pitch;
+		int x = 0;
 
-		for(int y = 0; y < rect.h(); y++)
+#if defined(TILESET_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i opaqueAlpha = _mm_set1_epi32(255);
+		const __m128i weightAlpha = _mm_set1_epi32(235);
+
+		__m128i sums = zero;			// R, G, B and A sums of weighted pixels.
+		__m128i weighted = zero;
+		__m128i opaque = zero;
+		__m128i clear = zero;
+
+		for(; x + 4 <= width; x += 4)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4));
+			__m128i alpha = _mm_srli_epi32(v, 24);
+
+			// Comparison masks are all ones, -1, so subtracting them counts.
+			__m128i isWeighted = _mm_cmpgt_epi32(alpha, weightAlpha);
+			weighted = _mm_sub_epi32(weighted, isWeighted);
+			opaque = _mm_sub_epi32(opaque, _mm_cmpeq_epi32(alpha, opaqueAlpha));
+			clear = _mm_sub_epi32(clear, _mm_cmpeq_epi32(alpha, zero));
+
+			__m128i w = _mm_and_si128(v, isWeighted);
+			__m128i pairs = _mm_add_epi16(_mm_unpacklo_epi8(w, zero), _mm_unpackhi_epi8(w, zero));
+			sums = _mm_add_epi32(sums, _mm_add_epi32(_mm_unpacklo_epi16(pairs, zero), _mm_unpackhi_epi16(pairs, zero)));
+		}
+
+		unsigned int lanes[4];
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+		totals.red += lanes[0];
+		totals.green += lanes[1];
+		totals.blue += lanes[2];
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), weighted);
+		totals.weighted += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), opaque);
+		totals.opaque += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), clear);
+		totals.clear += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+		for(; x < width; x++)
 		{
-			for(int x = 0; x < rect.w(); x++)
+			const unsigned char* pixel = row + x * 4;
+
+			if(pixel[3] == 255)
+				totals.opaque++;
+			else if(pixel[3] == 0)
+				totals.clear++;
+
+			if(pixel[3] > 235)
 			{
-				Color_4ub& c = mTileset.pixelColor(rect.x() + x, rect.y() + y);
-
-				if(c.alpha() > 235)
-				{
-					r += c.red();
-					g += c.green();
-					b += c.blue();
-					a += c.alpha();
-					pixel_count++;
-				}
+				totals.red += pixel[0];
+				totals.green += pixel[1];
+				totals.blue += pixel[2];
+				totals.weighted++;
 			}
 		}
+	}
+}
 
-		if(pixel_count > 0)
+
+/**
+ * Builds the average color and opacity classification of every tile.
+ * 
+ * Rows of tiles are spread across a ThreadPool. Progress is reported as
+ * rows finish and rows that haven't started yet are skipped once the load
+ * is cancelled.
+ */
+void Tileset::fillTileColorList(Data& data, LoadProgress* progress)
+{
+	TraceScope trace("Tileset::fillTileColorList", "tileset");
+
+	const int tilesWide = data.tilesetDimensions.x();
+	const int tilesHigh = data.tilesetDimensions.y();
+
+	data.averageColors.resize(tilesWide * tilesHigh);
+	data.opacities.resize(tilesWide * tilesHigh);
+
+	const size_t pitch = static_cast<size_t>(data.imageDimensions.x()) * 4;
+	const int tileArea = data.tileDimensions.x() * data.tileDimensions.y();
+
+	std::atomic<int> rowsDone(0);
+
+	ThreadPool pool(std::min(std::thread::hardware_concurrency(), static_cast<unsigned int>(std::max(tilesHigh, 1))));
+
+	for(int row = 0; row < tilesHigh; row++)
+	{
+		pool.enqueue([&data, &rowsDone, progress, row, tilesWide, tilesHigh, pitch, tileArea]
 		{
-			r /= pixel_count;
-			g /= pixel_count;
-			b /= pixel_count;
-			a /= pixel_count;
+			if(progress && progress->cancelled())
+				return;
+
+			TraceScope trace("Tileset::analyzeRow", "tileset");
+
+			for(int col = 0; col < tilesWide; col++)
+			{
+				const int i = row * tilesWide + col;
+				const Rectangle_2d rect = getTsetCoordsFromIndex(data, i);
+
+				PixelTotals totals;
+				analyzeTile(&data.pixels[rect.y() * pitch + rect.x() * 4], pitch, rect.w(), rect.h(), totals);
+
+				if(totals.weighted > 0)
+					data.averageColors[i](totals.red / totals.weighted, totals.green / totals.weighted, totals.blue / totals.weighted, 255);
+				else
+					data.averageColors[i] = COLOR_CLEAR;
+
+				if(totals.opaque == static_cast<unsigned int>(tileArea))
+					data.opacities[i] = TILE_OPAQUE;
+				else if(totals.clear == static_cast<unsigned int>(tileArea))
+					data.opacities[i] = TILE_EMPTY;
+				else
+					data.opacities[i] = TILE_PARTIAL;
+			}
+
+			if(progress)
+				progress->progress(static_cast<float>(++rowsDone) / tilesHigh);
+		});
+	}
+
+	pool.wait();
+}
 
-			mAverageTileColorsList[i](r, g, b, 255);
-		}
-		else
-			mAverageTileColorsList[i] = COLOR_CLEAR;
 
+/**
+ * Gets the path of the metadata cache file kept next to a tileset image.
+ */
+static string cachePath(const string& path)
+{
+	return path + TILESET_CACHE_EXTENSION;
+}
+
+
+/**
+ * Reads the tile metadata of a tileset from its cache file.
+ * 
+ * \param	hash	CRC-32 of the tileset image file.
+ * 
+ * \return	False if there's no cache file or it was made from a different
+ *			image or for a different tile size.
+ */
+bool Tileset::readCache(const string& path, unsigned int hash, Data& data)
+{
+	TraceScope trace("Tileset::readCache", "tileset");
+
+	Filesystem& f = Utility<Filesystem>::get();
+	if(!f.exists(cachePath(path)))
+		return false;
+
+	File file = f.open(cachePath(path));
+
+	TilesetCacheHeader header;
+	if(file.size() < static_cast<int>(sizeof(header)))
+		return false;
+
+	memcpy(&header, file.raw_bytes(), sizeof(header));
+
+	const int numTiles = data.tilesetDimensions.x() * data.tilesetDimensions.y();
+
+	if(memcmp(header.magic, TILESET_CACHE_MAGIC, sizeof(TILESET_CACHE_MAGIC)) != 0 || header.version != TILESET_CACHE_VERSION ||
+		header.hash != hash || header.tileWidth != data.tileDimensions.x() || header.tileHeight != data.tileDimensions.y() ||
+		header.numTiles != numTiles || file.size() != static_cast<int>(sizeof(header) + numTiles * 5))
+	{
+		return false;
 	}
-}
\ No newline at end of file
+
+	const unsigned char* colors = reinterpret_cast<const unsigned char*>(file.raw_bytes()) + sizeof(header);
+	const unsigned char* opacities = colors + numTiles * 4;
+
+	data.averageColors.resize(numTiles);
+	data.opacities.resize(numTiles);
+
+	for(int i = 0; i < numTiles; i++)
+	{
+		if(opacities[i] > TILE_OPAQUE)
+			return false;
+
+		data.averageColors[i](colors[i * 4], colors[i * 4 + 1], colors[i * 4 + 2], colors[i * 4 + 3]);
+		data.opacities[i] = static_cast<TileOpacity>(opacities[i]);
+	}
+
+	return true;
+}
+
+
+/**
+ * Writes the tile metadata of a tileset to its cache file. Failing to is
+ * harmless, the tiles are analyzed again the next time.
+ */
+void Tileset::writeCache(const string& path, unsigned int hash, const Data& data)
+{
+	TraceScope trace("Tileset::writeCache", "tileset");
+
+	const int numTiles = static_cast<int>(data.opacities.size());
+
+	TilesetCacheHeader header;
+	memcpy(header.magic, TILESET_CACHE_MAGIC, sizeof(TILESET_CACHE_MAGIC));
+	header.version = TILESET_CACHE_VERSION;
+	header.hash = hash;
+	header.tileWidth = data.tileDimensions.x();
+	header.tileHeight = data.tileDimensions.y();
+	header.numTiles = numTiles;
+
+	string buffer(sizeof(header) + numTiles * 5, '\0');
+	memcpy(&buffer[0], &header, sizeof(header));
+
+	for(int i = 0; i < numTiles; i++)
+	{
+		const Color_4ub& c = data.averageColors[i];
+		buffer[sizeof(header) + i * 4] = static_cast<char>(c.red());
+		buffer[sizeof(header) + i * 4 + 1] = static_cast<char>(c.green());
+		buffer[sizeof(header) + i * 4 + 2] = static_cast<char>(c.blue());
+		buffer[sizeof(header) + i * 4 + 3] = static_cast<char>(c.alpha());
+		buffer[sizeof(header) + numTiles * 4 + i] = static_cast<char>(data.opacities[i]);
+	}
+
+	if(!writeFileAtomic(cachePath(path), buffer))
+		cout << "Unable to write tileset cache '" << cachePath(path) << "'." << endl;
+}
@@ -3,65 +3,168 @@
 
 #include "NAS2D/Resources/Image.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
 using namespace NAS2D;
 
+class LoadProgress;
+
+extern const std::string TILESET_CACHE_EXTENSION;
+
+extern const int TILESET_PAGE_SIZE;
+
 /**
  * \class	Tileset
  * \brief	A basic tileset class.
+ * 
+ * The tileset image is decoded and analyzed on whichever thread constructs
+ * the Tileset so that a Tileset can be loaded off the main thread. The
+ * decoded pixels are kept for drawing tiles on the CPU, see
+ * drawTileToBuffer(), and for creating textures.
+ * 
+ * The image is split into pages of at most TILESET_PAGE_SIZE pixels square,
+ * each holding a block of whole tiles, so that sheets larger than the GPU
+ * accepts can be drawn. A page's texture is only created the first time a
+ * tile on it is drawn and is released again once it hasn't been drawn for
+ * a while, see trimPages(). Tiles on different pages can't be drawn with
+ * the same texture bound so anything batching tiles has to group them by
+ * page().
+ * 
+ * The average color and opacity of every tile are saved to a cache file
+ * next to the image, see TILESET_CACHE_EXTENSION, and read back instead of
+ * being worked out again as long as the image's contents don't change.
+ * 
+ * Everything a Tileset knows is shared. Tilesets are kept in a process-wide
+ * cache keyed by path and tile size and constructing one for an image
+ * that's already cached and hasn't been modified since is only a lookup.
+ * Copies share the decoded image, the page textures and the per-tile data.
  */
 class Tileset
 {
 public:
 
-	Tileset() {}
+	/**
+	 * How much of a tile's area is covered by its pixels.
+	 */
+	enum TileOpacity
+	{
+		TILE_EMPTY,			/**< Every pixel is fully transparent. */
+		TILE_PARTIAL,		/**< Some pixels are transparent or translucent. */
+		TILE_OPAQUE			/**< Every pixel is fully opaque. */
+	};
+
+public:
+
+	Tileset();
+	Tileset(const std::string& path, int tileWidth, int tileHeight, LoadProgress* progress = nullptr);
 
-	Tileset(const std::string& path, int tileWidth, int tileHeight);
+	static void trimCache();
+	static void clearCache();
 
 	void drawTile(int index, int x, int y);
 
-	void drawTileToImage(Image& img, int index, int x, int y);
+	void drawTileToBuffer(int index, unsigned char* buffer, size_t pitch) const;
 
 	/**
 	 * Gets the width of a Tile.
 	 */
-	int width() const { return mTileDimensions.x(); }
+	int width() const { return mData->tileDimensions.x(); }
 	
 	/**
 	 * Gets the height of a Tile.
 	 */
-	int height() const { return mTileDimensions.y(); }
+	int height() const { return mData->tileDimensions.y(); }
 
-	int halfWidth() const { return mTileHalfDimensions.x(); }
-	int halfHeight() const { return mTileHalfDimensions.y(); }
+	int halfWidth() const { return mData->tileHalfDimensions.x(); }
+	int halfHeight() const { return mData->tileHalfDimensions.y(); }
 
-	int numTiles() const { return mTilesetDimensions.x() * mTilesetDimensions.y(); }
+	int numTiles() const { return mData->tilesetDimensions.x() * mData->tilesetDimensions.y(); }
 
-	const std::string& filepath() const { return mTsetPath; }
+	const std::string& filepath() const { return mData->path; }
+
+	int pageCount() const { return static_cast<int>(mData->pages.size()); }
+	int page(int index) const;
+
+	unsigned int textureId(int page) const;
+	Rectangle_2df textureCoords(int index) const;
+
+	void trimPages() const;
 
 	const Color_4ub& averageColor(int index);
 
+	TileOpacity opacity(int index) const;
+
 	void drawTileColorPalette(int x, int y, int cell_size, int columns = 16);
 
 private:
 	typedef std::vector<Color_4ub> ColorList;
+	typedef std::vector<TileOpacity> OpacityList;
+
+	/**
+	 * A block of tiles that's turned into a texture of its own.
+	 */
+	struct Page
+	{
+		Page(): lastUsed(0), resident(false) {}
+
+		Image						image;		/**< Texture of the page. Only valid while resident. */
+		std::vector<unsigned char>	pixels;		/**< Pixels of the page unless it covers the whole image. Kept for as long as image is. */
+		unsigned int				lastUsed;	/**< Value of Data::frame when the page was last drawn. */
+		bool						resident;	/**< Whether image has been created from the tileset pixels. */
+	};
+
+	typedef std::vector<Page> PageList;
+
+	/**
+	 * Everything that's shared between copies of a Tileset.
+	 */
+	struct Data
+	{
+		Data(): frame(0) {}
+
+		std::vector<unsigned char>	pixels;				/**< Decoded RGBA pixels of the tileset image. */
+
+		Point_2d					imageDimensions;	/**< Size of the tileset image in pixels. */
+
+		std::string					path;				/**< Path of the tileset image. */
+
+		Point_2d					tileDimensions;		/**< Size of a tile in pixels. */
+		Point_2d					tileHalfDimensions;	/**< Half the size of a tile in pixels. */
+		Point_2d					tilesetDimensions;	/**< Size of the tileset in tiles. */
+
+		ColorList					averageColors;		/**< Average color of each tile. */
+		OpacityList					opacities;			/**< Opacity of each tile. */
+
+		Point_2d					pageTiles;			/**< Size of a full page in tiles. */
+		Point_2d					pagesDimensions;	/**< Size of the tileset in pages. */
+
+		mutable PageList			pages;				/**< Pages in row-major order. Only touched on the thread that owns the OpenGL context. */
+		mutable unsigned int		frame;				/**< Number of times trimPages() was called. */
+	};
+
+	typedef std::shared_ptr<const Data> DataPtr;
+
+	struct Cache;
+	static Cache& cache();
+
+	static DataPtr load(const std::string& path, int tileWidth, int tileHeight, LoadProgress* progress);
 
-	void init();
-	void fillTileColorList();
+	static bool decode(const std::string& path, Data& data, unsigned int& hash);
+	static void fillTileColorList(Data& data, LoadProgress* progress);
 
-	const Rectangle_2d getTsetCoordsFromIndex(int index) const;
+	static bool readCache(const std::string& path, unsigned int hash, Data& data);
+	static void writeCache(const std::string& path, unsigned int hash, const Data& data);
 
-	Image		mTileset;
+	static void setupPages(Data& data);
 
-	std::string	mTsetPath;
+	static const Rectangle_2d getTsetCoordsFromIndex(const Data& data, int index);
+	const Rectangle_2d pageCoords(int page) const;
 
-	Point_2d	mTileDimensions;
-	Point_2d	mTileHalfDimensions;
-	Point_2d	mTilesetDimensions;
+	Page& residentPage(int page) const;
 
-	ColorList	mAverageTileColorsList;
+	DataPtr		mData;		/**< Shared tileset data. Never null. */
 };
 
 
@@ -0,0 +1,137 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * C'tor
+ */
+MappedFile::MappedFile():	mData(nullptr),
+							mSize(0)
+#if defined(_WIN32)
+							, mFile(nullptr),
+							mMapping(nullptr)
+#endif
+{}
+
+
+/**
+ * C'tor
+ * 
+ * \param	path	Native path of the file to map.
+ */
+MappedFile::MappedFile(const std::string& path):	mData(nullptr),
+													mSize(0)
+#if defined(_WIN32)
+													, mFile(nullptr),
+													mMapping(nullptr)
+#endif
+{
+	open(path);
+}
+
+
+/**
+ * D'tor
+ */
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+
+/**
+ * Maps a file into memory, unmapping any previously mapped file.
+ * 
+ * \return	True if the file was mapped. Empty files can't be mapped.
+ */
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mData = static_cast<const unsigned char*>(data);
+	mSize = static_cast<size_t>(size.QuadPart);
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	mData = static_cast<const unsigned char*>(data);
+	mSize = static_cast<size_t>(info.st_size);
+#endif
+
+	return true;
+}
+
+
+/**
+ * Unmaps the file. Safe to call when nothing is mapped.
+ */
+void MappedFile::close()
+{
+	if (!mData)
+		return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(mData);
+	CloseHandle(mMapping);
+	CloseHandle(mFile);
+	mMapping = nullptr;
+	mFile = nullptr;
+#else
+	munmap(const_cast<unsigned char*>(mData), mSize);
+#endif
+
+	mData = nullptr;
+	mSize = 0;
+}
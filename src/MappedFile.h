@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+/**
+ * \class MappedFile
+ * \brief Read-only memory mapping of a file on disk.
+ * 
+ * The contents of the file are paged in by the operating system as they're
+ * touched instead of being read into a buffer up front.
+ * 
+ * \note	Takes a native path, not a path within the NAS2D Filesystem.
+ */
+class MappedFile
+{
+public:
+
+	MappedFile();
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	bool open(const std::string& path);
+	void close();
+
+	bool opened() const { return mData != nullptr; }
+
+	const unsigned char* data() const { return mData; }
+	size_t size() const { return mSize; }
+
+private:
+
+	MappedFile(const MappedFile&);				// Explicitly disallowed
+	MappedFile& operator=(const MappedFile&);	// Explicitly disallowed
+
+	const unsigned char*	mData;		/**< Start of the mapped file. */
+	size_t					mSize;		/**< Size of the mapped file in bytes. */
+
+#if defined(_WIN32)
+	void*					mFile;		/**< File handle. */
+	void*					mMapping;	/**< File mapping handle. */
+#endif
+};
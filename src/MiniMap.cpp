@@ -1,6 +1,45 @@
 #include "MiniMap.h"
 
 #include "Common.h"
+#include "FrameProfiler.h"
+#include "OpenGL.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
+
+
+/**
+ * Number of entries in the packed color table. Covers every value of a
+ * GameField::TileIndex so lookups never need a bounds check.
+ */
+const int COLOR_TABLE_SIZE = 1 << (sizeof(GameField::TileIndex) * 8);
+
+
+/**
+ * Composes one run of minimap pixels from the spans of all four layers.
+ * Each pixel gets the color of the topmost non-empty layer.
+ * 
+ * 
+ * \note	The topmost index is picked without branches and only then looked
+ *			up so that the compiler can vectorize the loop.
+ */
+static void compositeRow(const GameField::TileIndex* const* layers, const Uint32* table, Uint32* out, int count)
+{
+	const GameField::TileIndex* base = layers[Cell::LAYER_BASE];
+	const GameField::TileIndex* baseDetail = layers[Cell::LAYER_BASE_DETAIL];
+	const GameField::TileIndex* detail = layers[Cell::LAYER_DETAIL];
+	const GameField::TileIndex* foreground = layers[Cell::LAYER_FOREGROUND];
+
+	for (int i = 0; i < count; i++)
+	{
+		GameField::TileIndex top = base[i];
+		top = baseDetail[i] != Cell::EMPTY_INDEX ? baseDetail[i] : top;
+		top = detail[i] != Cell::EMPTY_INDEX ? detail[i] : top;
+		top = foreground[i] != Cell::EMPTY_INDEX ? foreground[i] : top;
+
+		out[i] = table[static_cast<unsigned short>(top)];
+	}
+}
 
 
 MiniMap::MiniMap():
@@ -24,6 +63,11 @@ MiniMap::~MiniMap()
 	e.mouseButtonDown().Disconnect(this, &MiniMap::onMouseDown);
 	e.mouseButtonUp().Disconnect(this, &MiniMap::onMouseUp);
 	e.mouseMotion().Disconnect(this, &MiniMap::onMouseMotion);
+
+	delete mMiniMap;
+
+	if (mSurface)
+		SDL_FreeSurface(mSurface);
 }
 
 
@@ -102,6 +146,8 @@ void MiniMap::onMouseMotion(int x, int y, int relX, int relY)
 
 void MiniMap::update()
 {
+	ScopedTimer timer(STAGE_MINIMAP);
+
 	if (hidden())
 		return;
 
@@ -140,61 +186,142 @@ void MiniMap::map(Map* _m)
 	mRect(mRect.x(), mRect.y(), mMap->width() + 8, mMap->height() + 25);
 }
 
+/**
+ * Recomposites and uploads the entire minimap.
+ */
 void MiniMap::update_minimap()
 {
-	createMiniMap();
+	TraceScope trace("MiniMap::update_minimap", "minimap");
+
+	if (!mSurface)
+		return;
+
+	Rectangle_2d area(0, 0, mSurface->w, mSurface->h);
+	composite(area);
+	upload(area);
 }
 
 
+/**
+ * Recomposites and uploads only the cells within a given area.
+ * 
+ * \param	area	Dirty area in cells. Clipped to the map.
+ */
+void MiniMap::update_minimap(const Rectangle_2d& area)
+{
+	TraceScope trace("MiniMap::update_minimap(area)", "minimap");
+
+	if (!mSurface)
+		return;
+
+	int x1 = std::max(area.x(), 0);
+	int y1 = std::max(area.y(), 0);
+	int x2 = std::min(area.x() + area.w(), mSurface->w);
+	int y2 = std::min(area.y() + area.h(), mSurface->h);
+
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	Rectangle_2d clipped(x1, y1, x2 - x1, y2 - y1);
+	composite(clipped);
+	upload(clipped);
+}
+
+
+/**
+ * Builds the minimap surface and texture from scratch. Only needed when
+ * the map changes, edits go through update_minimap(const Rectangle_2d&).
+ */
 void MiniMap::createMiniMap()
 {
+	TraceScope trace("MiniMap::createMiniMap", "minimap");
+
 	Uint32 rmask, gmask, bmask, amask;
 
 	// Set up channel masks.
 	if (SDL_BYTEORDER == SDL_BIG_ENDIAN) { rmask = 0xff000000; gmask = 0x00ff0000;	bmask = 0x0000ff00;	amask = 0x000000ff; }
 	else { rmask = 0x000000ff;	gmask = 0x0000ff00;	bmask = 0x00ff0000;	amask = 0xff000000; }
 
+	if (mSurface)
+		SDL_FreeSurface(mSurface);
+
 	mSurface = SDL_CreateRGBSurface(0, mMap->width(), mMap->height(), 32, rmask, gmask, bmask, amask);
 	if (!mSurface)
 		return;
 
-	Color_4ub _c;
-	for (int y = 0; y < mMap->height(); y++)
+	buildColorTable();
+	composite(Rectangle_2d(0, 0, mSurface->w, mSurface->h));
+
+	if (mMiniMap)
+		delete mMiniMap;
+
+	mMiniMap = new Image(mSurface->pixels, mSurface->format->BytesPerPixel, mSurface->w, mSurface->h);
+}
+
+
+/**
+ * Packs the average color of every tile in the tileset into the format
+ * of the minimap surface. Indices outside of the tileset are clear.
+ */
+void MiniMap::buildColorTable()
+{
+	Tileset& tset = mMap->tileset();
+
+	mColorTable.assign(COLOR_TABLE_SIZE, SDL_MapRGBA(mSurface->format, 0, 0, 0, 0));
+
+	int count = std::min(tset.numTiles(), COLOR_TABLE_SIZE / 2);
+	for (int i = 0; i < count; i++)
+	{
+		const Color_4ub& _c = tset.averageColor(i);
+		mColorTable[i] = SDL_MapRGBA(mSurface->format, _c.red(), _c.green(), _c.blue(), _c.alpha());
+	}
+}
+
+
+/**
+ * Draws the cells within an area to the minimap surface.
+ */
+void MiniMap::composite(const Rectangle_2d& area)
+{
+	TraceScope trace("MiniMap::composite", "minimap");
+
+	GameField& field = mMap->field();
+
+	int lastX = area.x() + area.w();
+
+	const GameField::TileIndex* layers[Cell::LAYER_COUNT];
+
+	for (int y = area.y(); y < area.y() + area.h(); y++)
 	{
-		for (int x = 0; x < mMap->width(); x++)
+		Uint32* row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(mSurface->pixels) + y * mSurface->pitch);
+
+		for (int x = area.x(); x < lastX; )
 		{
-			Cell& cell = mMap->field().cell(x, y);
-
-			_c = mMap->tileset().averageColor(cell.index(Cell::LAYER_BASE));
-			DrawPixel(mSurface, x, y, _c.red(), _c.green(), _c.blue(), _c.alpha());
-
-			if (cell.index(Cell::LAYER_BASE_DETAIL) != -1)
-			{
-				_c = mMap->tileset().averageColor(cell.index(Cell::LAYER_BASE_DETAIL));
-				DrawPixel(mSurface, x, y, _c.red(), _c.green(), _c.blue(), _c.alpha());
-			}
-
-			if (cell.index(Cell::LAYER_DETAIL) != -1)
-			{
-				_c = mMap->tileset().averageColor(cell.index(Cell::LAYER_DETAIL));
-				DrawPixel(mSurface, x, y, _c.red(), _c.green(), _c.blue(), _c.alpha());
-			}
-
-			if (cell.index(Cell::LAYER_FOREGROUND) != -1)
-			{
-				_c = mMap->tileset().averageColor(cell.index(Cell::LAYER_FOREGROUND));
-				DrawPixel(mSurface, x, y, _c.red(), _c.green(), _c.blue(), _c.alpha());
-			}
+			for (int layer = 0; layer < Cell::LAYER_COUNT; layer++)
+				layers[layer] = field.span(static_cast<Cell::TileLayer>(layer), x, y);
+
+			int count = std::min(GameField::spanLength(x), lastX - x);
+			compositeRow(layers, &mColorTable[0], row + x, count);
+			x += count;
 		}
 	}
+}
 
 
-	if (mMiniMap)
-		delete mMiniMap;
+/**
+ * Copies an area of the minimap surface into the minimap texture.
+ */
+void MiniMap::upload(const Rectangle_2d& area)
+{
+	TraceScope trace("MiniMap::upload", "minimap");
 
+	if (!mMiniMap)
+		return;
 
-	mMiniMap = new Image(mSurface->pixels, mSurface->format->BytesPerPixel, mSurface->w, mSurface->h);
+	const Uint8* pixels = static_cast<const Uint8*>(mSurface->pixels) + area.y() * mSurface->pitch + area.x() * 4;
 
-	SDL_FreeSurface(mSurface);
-	mSurface = nullptr;
+	glBindTexture(GL_TEXTURE_2D, mMiniMap->texture_id());
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, mSurface->pitch / 4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, area.x(), area.y(), area.w(), area.h(), GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 }
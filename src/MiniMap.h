@@ -4,6 +4,8 @@
 
 #include "Map/Map.h"
 
+#include <vector>
+
 using namespace NAS2D;
 
 
@@ -30,6 +32,7 @@ public:
 	void update();
 
 	void update_minimap();
+	void update_minimap(const Rectangle_2d& area);
 
 private:
 
@@ -40,6 +43,10 @@ private:
 	void onMouseMotion(int x, int y, int relX, int relY);
 
 	void createMiniMap();
+	void buildColorTable();
+
+	void composite(const Rectangle_2d& area);
+	void upload(const Rectangle_2d& area);
 
 	void adjustCamera(int x, int y);
 
@@ -49,8 +56,10 @@ private:
 
 	Font*			mFont;
 
-	SDL_Surface*	mSurface;
-	Image*			mMiniMap;
+	SDL_Surface*	mSurface;		/**< Persistent CPU copy of the minimap, one pixel per cell. */
+	Image*			mMiniMap;		/**< Texture uploaded from mSurface. */
+
+	std::vector<Uint32>	mColorTable;	/**< Average color of every tile packed in mSurface's format, indexed by tile index as an unsigned short. */
 
 	Map*			mMap;
 
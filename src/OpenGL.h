@@ -0,0 +1,12 @@
+#pragma once
+
+/**
+ * Pulls in the OpenGL headers in the same way NAS2D does. Only needed by
+ * code that submits geometry directly instead of through the Renderer.
+ */
+
+#if defined(__APPLE__)
+#include <OpenGL/gl.h>
+#else
+#include "GL/glew.h"
+#endif
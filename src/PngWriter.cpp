@@ -0,0 +1,178 @@
+#include "PngWriter.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+
+const unsigned char	PNG_SIGNATURE[]			= { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+/**
+ * zlib stream header: deflate with a 32K window, no preset dictionary and
+ * the "fastest" level hint.
+ */
+const unsigned char	ZLIB_HEADER[]			= { 0x78, 0x01 };
+
+const int			PNG_COMPRESSION_LEVEL	= Z_BEST_SPEED;		/**< Renders are huge, speed wins over size. */
+
+const size_t		DEFLATE_BUFFER_SIZE		= 65536;
+
+const unsigned char	FILTER_SUB				= 1;
+
+
+static void putBigEndian(unsigned char* out, unsigned long value)
+{
+	out[0] = static_cast<unsigned char>(value >> 24);
+	out[1] = static_cast<unsigned char>(value >> 16);
+	out[2] = static_cast<unsigned char>(value >> 8);
+	out[3] = static_cast<unsigned char>(value);
+}
+
+
+/**
+ * Runs deflate over the input given to the stream, appending everything it
+ * produces to a string.
+ */
+static void deflateTo(z_stream& stream, int flush, std::string& out)
+{
+	unsigned char buffer[DEFLATE_BUFFER_SIZE];
+
+	do
+	{
+		stream.next_out = buffer;
+		stream.avail_out = sizeof(buffer);
+		deflate(&stream, flush);
+		out.append(reinterpret_cast<const char*>(buffer), sizeof(buffer) - stream.avail_out);
+	} while (stream.avail_out == 0);
+}
+
+
+/**
+ * C'tor
+ * 
+ * Writes the PNG signature and header.
+ */
+PngWriter::PngWriter(std::ostream& stream, int width, int height):	mStream(stream),
+																	mAdler(adler32(0, nullptr, 0)),
+																	mHeaderWritten(false)
+{
+	mStream.write(reinterpret_cast<const char*>(PNG_SIGNATURE), sizeof(PNG_SIGNATURE));
+
+	unsigned char header[13];
+	putBigEndian(header, static_cast<unsigned long>(width));
+	putBigEndian(header + 4, static_cast<unsigned long>(height));
+	header[8] = 8;		// Bit depth
+	header[9] = 6;		// Color type, RGBA
+	header[10] = 0;		// Compression method, deflate
+	header[11] = 0;		// Filter method
+	header[12] = 0;		// Interlace method, none
+
+	writeChunk("IHDR", header, sizeof(header));
+}
+
+
+/**
+ * Filters and compresses a band of rows.
+ * 
+ * \param	pixels	First row of RGBA pixels.
+ * \param	pitch	Bytes from one row to the next.
+ * \param	width	Width of the image in pixels.
+ * \param	rows	Number of rows in the band.
+ * \param	last	Whether this is the bottom band of the image.
+ * \param	band	Band to fill in.
+ * 
+ * \note	Safe to call from any thread.
+ */
+void PngWriter::compress(const unsigned char* pixels, size_t pitch, int width, int rows, bool last, Band& band)
+{
+	z_stream stream;
+	std::memset(&stream, 0, sizeof(stream));
+	deflateInit2(&stream, PNG_COMPRESSION_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+	const size_t rowBytes = static_cast<size_t>(width) * 4;
+	std::vector<unsigned char> filtered(rowBytes + 1);
+
+	band.data.clear();
+	band.adler = adler32(0, nullptr, 0);
+	band.length = 0;
+
+	for (int row = 0; row < rows; row++)
+	{
+		const unsigned char* src = pixels + row * pitch;
+
+		filtered[0] = FILTER_SUB;
+		std::memcpy(&filtered[1], src, std::min<size_t>(rowBytes, 4));
+		for (size_t i = 4; i < rowBytes; i++)
+			filtered[i + 1] = static_cast<unsigned char>(src[i] - src[i - 4]);
+
+		band.adler = adler32(band.adler, &filtered[0], static_cast<uInt>(filtered.size()));
+		band.length += filtered.size();
+
+		stream.next_in = &filtered[0];
+		stream.avail_in = static_cast<uInt>(filtered.size());
+		deflateTo(stream, Z_NO_FLUSH, band.data);
+	}
+
+	// A sync flush ends the band on a byte boundary without marking the
+	// last block as final so the next band's stream can follow it.
+	deflateTo(stream, last ? Z_FINISH : Z_SYNC_FLUSH, band.data);
+	deflateEnd(&stream);
+}
+
+
+/**
+ * Writes the next band of the image. Bands have to be written top to bottom.
+ */
+bool PngWriter::write(const Band& band)
+{
+	// The image data may be split across any number of IDAT chunks so the
+	// zlib header and trailer get chunks of their own.
+	if (!mHeaderWritten)
+	{
+		writeChunk("IDAT", ZLIB_HEADER, sizeof(ZLIB_HEADER));
+		mHeaderWritten = true;
+	}
+
+	writeChunk("IDAT", band.data.data(), band.data.size());
+
+	mAdler = adler32_combine(mAdler, band.adler, static_cast<z_off_t>(band.length));
+
+	return !mStream.fail();
+}
+
+
+/**
+ * Ends the zlib stream and the image. Call after the last band is written.
+ */
+bool PngWriter::finish()
+{
+	unsigned char trailer[4];
+	putBigEndian(trailer, mAdler);
+	writeChunk("IDAT", trailer, sizeof(trailer));
+
+	writeChunk("IEND", nullptr, 0);
+
+	return !mStream.fail();
+}
+
+
+void PngWriter::writeChunk(const char* type, const void* data, size_t length)
+{
+	unsigned char header[8];
+	putBigEndian(header, static_cast<unsigned long>(length));
+	std::memcpy(header + 4, type, 4);
+
+	unsigned long crc = crc32(0, header + 4, 4);
+	if (length > 0)
+		crc = crc32(crc, static_cast<const Bytef*>(data), static_cast<uInt>(length));
+
+	unsigned char footer[4];
+	putBigEndian(footer, crc);
+
+	mStream.write(reinterpret_cast<const char*>(header), sizeof(header));
+	if (length > 0)
+		mStream.write(static_cast<const char*>(data), length);
+	mStream.write(reinterpret_cast<const char*>(footer), sizeof(footer));
+}
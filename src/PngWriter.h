@@ -0,0 +1,55 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+/**
+ * \class PngWriter
+ * \brief Writes an 8-bit RGBA PNG one horizontal band at a time.
+ * 
+ * Bands are compressed independently of each other by compress(), which
+ * doesn't touch the writer and can run on any thread, then written in order
+ * with write(). Only the bands in flight are ever held in memory so images
+ * far larger than RAM can be written.
+ * 
+ * Each band is a separate raw deflate stream ending on a byte boundary, the
+ * streams are concatenated into the zlib stream of the image and their
+ * Adler-32 checksums combined, the same way pigz compresses in parallel.
+ * Every row uses the Sub filter.
+ */
+class PngWriter
+{
+public:
+
+	/**
+	 * Compressed rows of an image.
+	 */
+	struct Band
+	{
+		Band(): adler(1), length(0) {}
+
+		std::string		data;		/**< Raw deflate data. */
+		unsigned long	adler;		/**< Adler-32 of the filtered, uncompressed rows. */
+		size_t			length;		/**< Length of the filtered, uncompressed rows in bytes. */
+	};
+
+public:
+
+	PngWriter(std::ostream& stream, int width, int height);
+
+	static void compress(const unsigned char* pixels, size_t pitch, int width, int rows, bool last, Band& band);
+
+	bool write(const Band& band);
+	bool finish();
+
+private:
+
+	PngWriter(const PngWriter&);				// Explicitly disallowed
+	PngWriter& operator=(const PngWriter&);		// Explicitly disallowed
+
+	void writeChunk(const char* type, const void* data, size_t length);
+
+	std::ostream&	mStream;		/**< Stream the image goes to. */
+	unsigned long	mAdler;			/**< Adler-32 of everything written so far. */
+	bool			mHeaderWritten;	/**< Whether the zlib header has been written. */
+};
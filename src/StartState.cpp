@@ -1,6 +1,11 @@
 #include "StartState.h"
 
 #include "Defaults.h"
+#include "LoadingState.h"
+#include "ThreadPool.h"
+#include "TraceRecorder.h"
+
+#include "Map/Tileset.h"
 
 #include "Common.h"
 
@@ -52,6 +57,9 @@ void StartState::initialize()
 
 	mReturnState = this;
 
+	// Only the most recently used tilesets of maps that were closed stay cached.
+	Tileset::trimCache();
+
 	setMessage("");
 
 	mBtnCreateNew.font(mFont);
@@ -107,6 +115,8 @@ void StartState::initialize()
 	e.mouseMotion().Connect(this, &StartState::onMouseMove);
 	e.quit().Connect(this, &StartState::onQuit);
 
+	mMapIndex.load(EDITOR_MAP_INDEX_PATH);
+
 	fillTilesetMenu();
 }
 
@@ -115,27 +125,27 @@ void StartState::fillMapMenu()
 {
 	StringList lst = getFileList(EDITOR_MAPS_PATH);
 
-	for (size_t i = 0; i < lst.size(); ++i)
-	{
-		File xmlFile = Utility<Filesystem>::get().open(EDITOR_MAPS_PATH + lst[i]);
+	ThreadPool pool;
+	size_t count = mMapIndex.refresh(EDITOR_MAPS_PATH, lst, pool);
+	if (count > 0)
+		cout << "Indexed " << count << " of " << lst.size() << " files in '" << EDITOR_MAPS_PATH << "'." << endl;
 
-		TiXmlDocument doc;
-		TiXmlElement  *root = nullptr;
+	if (!mMapIndex.save(EDITOR_MAP_INDEX_PATH))
+		cout << "Unable to save map index '" << EDITOR_MAP_INDEX_PATH << "'." << endl;
 
-		doc.Parse(xmlFile.raw_bytes());
-		if (doc.Error())
+	for (size_t i = 0; i < lst.size(); ++i)
+	{
+		const MapIndex::Entry* entry = mMapIndex.find(lst[i]);
+		if (!entry || !entry->valid)
 			continue;
 
-		if (doc.FirstChildElement("map"))
+		if (!entry->compatible())
 		{
-			if (doc.FirstChildElement()->Attribute("version") != MAP_DRIVER_VERSION)
-			{
-				cout << "Map '" << EDITOR_MAPS_PATH + lst[i] << "' is version mismatched." << endl;
-				continue;
-			}
-
-			mMapFilesMenu.addItem(lst[i]);
+			cout << "Map '" << EDITOR_MAPS_PATH + lst[i] << "' is version mismatched." << endl;
+			continue;
 		}
+
+		mMapFilesMenu.addItem(lst[i]);
 	}
 
 	mBtnLoadExisting.enabled(!mMapFilesMenu.empty());
@@ -147,7 +157,13 @@ void StartState::fillTilesetMenu()
 	StringList lst = getFileList(EDITOR_TSET_PATH);
 
 	for (size_t i = 0; i < lst.size(); ++i)
+	{
+		// Skip the tile metadata caches kept next to tileset images.
+		if (lst[i].size() > TILESET_CACHE_EXTENSION.size() && lst[i].compare(lst[i].size() - TILESET_CACHE_EXTENSION.size(), string::npos, TILESET_CACHE_EXTENSION) == 0)
+			continue;
+
 		mTsetFilesMenu.addItem(lst[i]);
+	}
 }
 
 
@@ -240,19 +256,7 @@ void StartState::button_LoadExisting_click()
 		return;
 	}
 
-	/// Doing it this way only so that the user can get feedback about what the app is doing.
-	/// \todo	This would benefit by spinning loading maps into its own thread.
-	Utility<Renderer>::get().drawText(mFont, "LOADING MAP. PLEASE WAIT...", mLayoutRect.x(), 5, 255, 255, 0);
-	Utility<Renderer>::get().update();
-
-	try
-	{
-		mReturnState = new EditorState(mapPath);
-	}
-	catch (Exception& e)
-	{
-		setMessage("COULDN'T LOAD MAP: " + e.getDescription());
-	}
+	mReturnState = new LoadingState(mapPath);
 }
 
 
@@ -272,6 +276,8 @@ void StartState::button_RefreshLists_click()
  */
 State* StartState::update()
 {
+	TraceRecorder::instant("Frame", "frame");
+
 	Renderer& r = Utility<Renderer>::get();
 	r.clearScreen(COLOR_BLACK);
 
@@ -324,8 +330,12 @@ State* StartState::update()
  */
 void StartState::onKeyDown(KeyCode key, KeyModifier mod, bool repeat)
 {
+	TraceScope trace("StartState::onKeyDown", "event");
+
 	if(key == KEY_ESCAPE)
 		mReturnState = NULL;
+	else if(key == KEY_F8 && !repeat)
+		TraceRecorder::toggle(EDITOR_TRACE_PATH);
 }
 
 
@@ -334,6 +344,8 @@ void StartState::onKeyDown(KeyCode key, KeyModifier mod, bool repeat)
  */
 void StartState::onMouseMove(int x, int y, int relX, int relY)
 {
+	TraceScope trace("StartState::onMouseMove", "event");
+
 	mMouseCoords(x, y);
 }
 
@@ -4,6 +4,8 @@
 
 #include "EditorState.h"
 
+#include "Map/MapIndex.h"
+
 // UI
 #include "Button.h"
 #include "Menu.h"
@@ -14,6 +16,9 @@ using namespace std;
 using namespace NAS2D;
 
 
+void setMessage(const std::string& msg);
+
+
 /**
  * \class StartState
  * \brief Implements a startup state for the CoM Map Editor.
@@ -67,6 +72,8 @@ private:
 	Menu			mMapFilesMenu;		/**< Map File List menu. */
 	Menu			mTsetFilesMenu;		/**< Tileset File List menu. */
 
+	MapIndex		mMapIndex;			/**< Cached headers of the maps in EDITOR_MAPS_PATH. */
+
 	bool			mScanningMaps;
 
 	State*			mReturnState;		/**< State to return during updates. */
@@ -0,0 +1,100 @@
+#include "ThreadPool.h"
+
+#include "TraceRecorder.h"
+
+
+/**
+ * C'tor
+ * 
+ * \param	threads		Number of worker threads. 0 uses one per hardware thread.
+ */
+ThreadPool::ThreadPool(unsigned int threads):	mBusy(0),
+												mStopping(false)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+
+	if (threads == 0)
+		threads = 1;
+
+	mWorkers.reserve(threads);
+	for (unsigned int i = 0; i < threads; i++)
+		mWorkers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+
+/**
+ * D'tor
+ * 
+ * Lets queued tasks finish before the workers are joined.
+ */
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+
+	mTaskReady.notify_all();
+
+	for (size_t i = 0; i < mWorkers.size(); i++)
+		mWorkers[i].join();
+}
+
+
+/**
+ * Queues a task to be run by the next free worker.
+ */
+void ThreadPool::enqueue(const Task& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push_back(task);
+	}
+
+	mTaskReady.notify_one();
+}
+
+
+/**
+ * Blocks until every queued task has been run.
+ */
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mIdle.wait(lock, [this] { return mTasks.empty() && mBusy == 0; });
+}
+
+
+/**
+ * Worker thread loop.
+ */
+void ThreadPool::work()
+{
+	TraceRecorder::nameThread("ThreadPool worker");
+
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	for (;;)
+	{
+		mTaskReady.wait(lock, [this] { return mStopping || !mTasks.empty(); });
+
+		if (mTasks.empty())
+			return;
+
+		Task task = std::move(mTasks.front());
+		mTasks.pop_front();
+		mBusy++;
+
+		lock.unlock();
+		{
+			TraceScope trace("ThreadPool task", "task");
+			task();
+		}
+		lock.lock();
+
+		mBusy--;
+		if (mTasks.empty() && mBusy == 0)
+			mIdle.notify_all();
+	}
+}
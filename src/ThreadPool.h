@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \class ThreadPool
+ * \brief Fixed set of worker threads that run queued tasks.
+ * 
+ * Tasks are run in the order they're queued by whichever worker is free.
+ * wait() blocks until the queue is empty and every worker is idle so a batch
+ * of tasks can be queued and then collected.
+ * 
+ * \note	Tasks must not throw.
+ */
+class ThreadPool
+{
+public:
+
+	typedef std::function<void()> Task;
+
+public:
+
+	explicit ThreadPool(unsigned int threads = 0);
+	~ThreadPool();
+
+	void enqueue(const Task& task);
+	void wait();
+
+	size_t size() const { return mWorkers.size(); }
+
+private:
+
+	ThreadPool(const ThreadPool&);				// Explicitly disallowed
+	ThreadPool& operator=(const ThreadPool&);	// Explicitly disallowed
+
+	void work();
+
+	std::vector<std::thread>	mWorkers;		/**< Worker threads. */
+	std::deque<Task>			mTasks;			/**< Tasks waiting for a worker. */
+
+	std::mutex					mMutex;			/**< Guards everything below. */
+	std::condition_variable		mTaskReady;		/**< Signalled when a task is queued or the pool shuts down. */
+	std::condition_variable		mIdle;			/**< Signalled when a worker finishes a task. */
+
+	size_t						mBusy;			/**< Number of workers running a task. */
+	bool						mStopping;		/**< Set when the pool is being destroyed. */
+};
@@ -1,6 +1,7 @@
 #include "TilePalette.h"
 
 #include "Common.h"
+#include "FrameProfiler.h"
 
 const Point_2d		PALETTE_DIMENSIONS		= Point_2d(196, 300);
 
@@ -133,6 +134,8 @@ void TilePalette::hidden(bool hidden)
  */
 void TilePalette::update()
 {
+	ScopedTimer timer(STAGE_TILE_PALETTE);
+
 	if (hidden())
 		return;
 
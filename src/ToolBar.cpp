@@ -2,6 +2,7 @@
 
 
 #include "Common.h"
+#include "FrameProfiler.h"
 
 
 const int BUTTON_SPACE = 2;
@@ -199,6 +200,8 @@ void drawSeparator(Button& btn, int margin)
 
 void ToolBar::update()
 {
+	ScopedTimer timer(STAGE_TOOLBAR);
+
 	Renderer& r = Utility<Renderer>::get();
 	bevelBox(0, 0, r.width(), 32);
 
@@ -0,0 +1,299 @@
+#include "TraceRecorder.h"
+
+#include "Common.h"
+
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+
+std::atomic<bool> TRACE_RECORDING(false);
+
+const size_t CHUNK_EVENTS = 4096;		/**< Number of events in each block of a thread's buffer. */
+
+
+/**
+ * A recorded event. Times are clock ticks since recording started.
+ */
+struct TraceEvent
+{
+	const char*			name;
+	const char*			category;
+	TraceRecorder::Clock::rep	start;
+	TraceRecorder::Clock::rep	duration;
+	char				phase;
+};
+
+
+/**
+ * Fixed size block of events. Blocks are chained and never freed so that a
+ * reader can walk them while the owning thread appends.
+ */
+struct TraceChunk
+{
+	TraceChunk(): next(nullptr) {}
+
+	TraceEvent					events[CHUNK_EVENTS];
+	std::atomic<TraceChunk*>	next;
+};
+
+
+/**
+ * Events recorded by one thread. Only the owning thread writes to it,
+ * count is published with release semantics after each event is complete
+ * so stop() can read everything up to it without a lock.
+ */
+struct ThreadBuffer
+{
+	ThreadBuffer(int _id): first(new TraceChunk()), last(first), count(0), session(0), id(_id), name(nullptr), inUse(true) {}
+
+	TraceChunk*					first;		/**< First block of events. */
+	TraceChunk*					last;		/**< Block being appended to. Owner only. */
+	std::atomic<size_t>			count;		/**< Number of complete events. */
+	std::atomic<unsigned int>	session;	/**< Recording the events belong to. */
+
+	int							id;			/**< Track the events are shown on. */
+	std::atomic<const char*>	name;		/**< Name of the thread, if it was given one. */
+	std::atomic<bool>			inUse;		/**< Whether a live thread owns the buffer. */
+};
+
+
+static std::mutex					BUFFERS_MUTEX;		// Guards BUFFERS.
+static std::vector<ThreadBuffer*>	BUFFERS;			// Buffers of every thread that has recorded anything. Never freed.
+
+static std::atomic<unsigned int>	SESSION(0);			// Incremented by every start().
+static std::atomic<TraceRecorder::Clock::rep>	EPOCH(0);	// Time recording started.
+
+
+/**
+ * Hands a thread's buffer back for reuse by a later thread when the thread
+ * exits. Threads of short lived pools end up sharing a track.
+ */
+struct ThreadBufferOwner
+{
+	ThreadBufferOwner(): buffer(nullptr), name(nullptr) {}
+	~ThreadBufferOwner() { if (buffer) buffer->inUse = false; }
+
+	ThreadBuffer*	buffer;
+	const char*		name;		/**< Name given to the thread, applied to the buffer once it has one. */
+};
+
+
+static thread_local ThreadBufferOwner THREAD_BUFFER;
+
+
+/**
+ * Gets the calling thread's buffer, registering one on first use.
+ */
+static ThreadBuffer& threadBuffer()
+{
+	if (THREAD_BUFFER.buffer)
+		return *THREAD_BUFFER.buffer;
+
+	std::lock_guard<std::mutex> lock(BUFFERS_MUTEX);
+
+	for (size_t i = 0; i < BUFFERS.size() && !THREAD_BUFFER.buffer; i++)
+	{
+		bool expected = false;
+		if (BUFFERS[i]->inUse.compare_exchange_strong(expected, true))
+			THREAD_BUFFER.buffer = BUFFERS[i];
+	}
+
+	if (!THREAD_BUFFER.buffer)
+	{
+		BUFFERS.push_back(new ThreadBuffer(static_cast<int>(BUFFERS.size()) + 1));
+		THREAD_BUFFER.buffer = BUFFERS.back();
+	}
+
+	THREAD_BUFFER.buffer->name.store(THREAD_BUFFER.name, std::memory_order_release);
+
+	return *THREAD_BUFFER.buffer;
+}
+
+
+/**
+ * Appends an event to the calling thread's buffer.
+ */
+static void append(const TraceEvent& event)
+{
+	ThreadBuffer& buffer = threadBuffer();
+
+	// The first event of a new recording starts the buffer over.
+	size_t count = buffer.count.load(std::memory_order_relaxed);
+	unsigned int session = SESSION.load(std::memory_order_acquire);
+	if (buffer.session.load(std::memory_order_relaxed) != session)
+	{
+		buffer.session.store(session, std::memory_order_relaxed);
+		buffer.last = buffer.first;
+		count = 0;
+	}
+
+	if (count > 0 && count % CHUNK_EVENTS == 0)
+	{
+		TraceChunk* next = buffer.last->next.load(std::memory_order_relaxed);
+		if (!next)
+		{
+			next = new TraceChunk();
+			buffer.last->next.store(next, std::memory_order_release);
+		}
+
+		buffer.last = next;
+	}
+
+	buffer.last->events[count % CHUNK_EVENTS] = event;
+	buffer.count.store(count + 1, std::memory_order_release);
+}
+
+
+/**
+ * Writes a time in clock ticks as microseconds.
+ */
+static void writeTime(std::ostream& stream, TraceRecorder::Clock::rep ticks)
+{
+	stream << std::chrono::duration<double, std::micro>(TraceRecorder::Clock::duration(ticks)).count();
+}
+
+
+/**
+ * Starts recording. Events of an earlier recording are discarded.
+ */
+void TraceRecorder::start()
+{
+	EPOCH.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+	SESSION.fetch_add(1, std::memory_order_release);
+	TRACE_RECORDING.store(true, std::memory_order_release);
+}
+
+
+/**
+ * Stops recording and writes everything recorded to a trace event JSON
+ * file.
+ *
+ * Events still being recorded by other threads as recording stops may or
+ * may not make it into the file.
+ */
+bool TraceRecorder::stop(const std::string& path)
+{
+	TRACE_RECORDING.store(false, std::memory_order_release);
+
+	const unsigned int session = SESSION.load(std::memory_order_acquire);
+
+	vector<ThreadBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(BUFFERS_MUTEX);
+		buffers = BUFFERS;
+	}
+
+	return writeFileAtomic(path, [&](std::ostream& stream)
+	{
+		stream << std::fixed << std::setprecision(3);
+		stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+		bool first = true;
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			ThreadBuffer& buffer = *buffers[i];
+
+			const char* name = buffer.name.load(std::memory_order_acquire);
+			if (name)
+			{
+				stream << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.id << ",\"args\":{\"name\":\"" << name << "\"}}";
+				first = false;
+			}
+
+			// A buffer that hasn't recorded anything since start() still
+			// holds the events of an earlier recording.
+			size_t count = buffer.count.load(std::memory_order_acquire);
+			if (count == 0 || buffer.session.load(std::memory_order_relaxed) != session)
+				continue;
+
+			const TraceChunk* chunk = buffer.first;
+			for (size_t n = 0; n < count; n++)
+			{
+				if (n > 0 && n % CHUNK_EVENTS == 0)
+					chunk = chunk->next.load(std::memory_order_acquire);
+
+				const TraceEvent& event = chunk->events[n % CHUNK_EVENTS];
+
+				stream << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" << buffer.id << ",\"ts\":";
+				writeTime(stream, event.start);
+
+				if (event.phase == 'X')
+				{
+					stream << ",\"dur\":";
+					writeTime(stream, event.duration);
+				}
+				else
+				{
+					stream << ",\"s\":\"g\"";
+				}
+
+				stream << "}";
+				first = false;
+			}
+		}
+
+		stream << "\n]}\n";
+
+		return stream.good() && session == SESSION.load(std::memory_order_acquire);
+	});
+}
+
+
+/**
+ * Starts recording if it's off, otherwise stops it and writes the trace.
+ */
+void TraceRecorder::toggle(const std::string& path)
+{
+	if (!recording())
+	{
+		start();
+		cout << "Recording trace." << endl;
+		return;
+	}
+
+	if (stop(path))
+		cout << "Saved trace to '" << path << "'." << endl;
+	else
+		cout << "Unable to save trace to '" << path << "'." << endl;
+}
+
+
+/**
+ * Names the calling thread's track. Doesn't register a buffer, threads
+ * that never record anything don't show up in the trace.
+ */
+void TraceRecorder::nameThread(const char* name)
+{
+	THREAD_BUFFER.name = name;
+
+	if (THREAD_BUFFER.buffer)
+		THREAD_BUFFER.buffer->name.store(name, std::memory_order_release);
+}
+
+
+/**
+ * Records an event that started at BEGIN and ended at END.
+ */
+void TraceRecorder::complete(const char* name, const char* category, Clock::time_point begin, Clock::time_point end)
+{
+	TraceEvent event = { name, category, begin.time_since_epoch().count() - EPOCH.load(std::memory_order_relaxed), (end - begin).count(), 'X' };
+	append(event);
+}
+
+
+/**
+ * Records an event without a duration, shown as a line across every
+ * track. Used to mark frame boundaries.
+ */
+void TraceRecorder::instant(const char* name, const char* category)
+{
+	if (!recording())
+		return;
+
+	TraceEvent event = { name, category, Clock::now().time_since_epoch().count() - EPOCH.load(std::memory_order_relaxed), 0, 'i' };
+	append(event);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+extern std::atomic<bool> TRACE_RECORDING;
+
+/**
+ * \class TraceRecorder
+ * \brief Records what the editor is doing as Chrome trace events.
+ *
+ * While recording, every TraceScope becomes a complete ("X") event on the
+ * track of the thread it ran on. The file written by stop() can be opened
+ * in chrome://tracing or Perfetto.
+ *
+ * Each thread appends to a buffer of its own without taking a lock. Only
+ * the first event a thread records takes a lock, to register the buffer.
+ * When recording is off a TraceScope costs one relaxed atomic load.
+ *
+ * \note	Event names and categories aren't copied and have to outlive the
+ *			recording. String literals are expected.
+ */
+class TraceRecorder
+{
+public:
+
+	typedef std::chrono::steady_clock Clock;
+
+public:
+
+	/**
+	 * Gets whether events are being recorded.
+	 */
+	static bool recording() { return TRACE_RECORDING.load(std::memory_order_relaxed); }
+
+	static void start();
+	static bool stop(const std::string& path);
+	static void toggle(const std::string& path);
+
+	static void nameThread(const char* name);
+
+	static void complete(const char* name, const char* category, Clock::time_point begin, Clock::time_point end);
+	static void instant(const char* name, const char* category);
+
+private:
+
+	TraceRecorder();		// Explicitly disallowed
+};
+
+
+/**
+ * \class TraceScope
+ * \brief Records the time between its construction and destruction as a
+ *		  trace event, if recording.
+ */
+class TraceScope
+{
+public:
+
+	TraceScope(const char* name, const char* category):	mName(TraceRecorder::recording() ? name : nullptr),
+														mCategory(category)
+	{
+		if (mName)
+			mStart = TraceRecorder::Clock::now();
+	}
+
+	~TraceScope()
+	{
+		if (mName)
+			TraceRecorder::complete(mName, mCategory, mStart, TraceRecorder::Clock::now());
+	}
+
+private:
+
+	TraceScope(const TraceScope&);				// Explicitly disallowed
+	TraceScope& operator=(const TraceScope&);	// Explicitly disallowed
+
+	const char*						mName;		/**< Name of the event. Null when recording was off as the scope began. */
+	const char*						mCategory;	/**< Category of the event. */
+	TraceRecorder::Clock::time_point	mStart;		/**< Time the scope began. */
+};
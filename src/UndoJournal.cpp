@@ -0,0 +1,317 @@
+#include "UndoJournal.h"
+
+#include "TraceRecorder.h"
+
+#include <algorithm>
+
+const size_t UNDO_DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+
+/**
+ * Gets the approximate number of bytes used by an entry.
+ */
+size_t UndoJournal::Entry::bytes() const
+{
+	size_t _b = sizeof(Entry) + changes.capacity() * sizeof(Change) + linkChanges.capacity() * sizeof(LinkChange);
+
+	for (size_t i = 0; i < linkChanges.size(); i++)
+		_b += linkChanges[i].beforeDestination.capacity() + linkChanges[i].afterDestination.capacity();
+
+	return _b;
+}
+
+
+/**
+ * Grows the bounds of an entry to include a given cell.
+ */
+void UndoJournal::Entry::include(int x, int y)
+{
+	if (maxX < minX)
+	{
+		minX = maxX = x;
+		minY = maxY = y;
+		return;
+	}
+
+	minX = std::min(minX, x);
+	minY = std::min(minY, y);
+	maxX = std::max(maxX, x);
+	maxY = std::max(maxY, y);
+}
+
+
+/**
+ * C'tor
+ */
+UndoJournal::UndoJournal():	mField(nullptr),
+							mBudget(UNDO_DEFAULT_BUDGET),
+							mMemoryUsed(0),
+							mRecording(false)
+{}
+
+
+/**
+ * Sets the GameField the journal records edits for. Clears all
+ * undo and redo history.
+ */
+void UndoJournal::field(GameField* field)
+{
+	mField = field;
+	clear();
+}
+
+
+/**
+ * Sets the maximum number of bytes the journal may use. The most recent
+ * entry is always kept, even if it alone is over budget.
+ */
+void UndoJournal::budget(size_t bytes)
+{
+	mBudget = bytes;
+	enforceBudget();
+}
+
+
+/**
+ * Starts recording a stroke. Constant time.
+ */
+void UndoJournal::beginStroke()
+{
+	TraceScope trace("UndoJournal::beginStroke", "undo");
+
+	if (mRecording)
+		endStroke();
+
+	mStroke = Entry();
+	mRecording = true;
+}
+
+
+/**
+ * Finishes recording a stroke and pushes it onto the undo list. Strokes
+ * that didn't change anything are discarded.
+ */
+void UndoJournal::endStroke()
+{
+	TraceScope trace("UndoJournal::endStroke", "undo");
+
+	if (!mRecording)
+		return;
+
+	mRecording = false;
+
+	mLastChangedArea = Rectangle_2d(mStroke.minX, mStroke.minY, mStroke.maxX - mStroke.minX + 1, mStroke.maxY - mStroke.minY + 1);
+
+	if (mStroke.changes.empty() && mStroke.linkChanges.empty())
+		return;
+
+	mStroke.changes.shrink_to_fit();
+
+	for (size_t i = 0; i < mRedo.size(); i++)
+		mMemoryUsed -= mRedo[i].bytes();
+	mRedo.clear();
+
+	mUndo.push_back(Entry());
+	mUndo.back().changes.swap(mStroke.changes);
+	mUndo.back().linkChanges.swap(mStroke.linkChanges);
+	mUndo.back().minX = mStroke.minX;
+	mUndo.back().minY = mStroke.minY;
+	mUndo.back().maxX = mStroke.maxX;
+	mUndo.back().maxY = mStroke.maxY;
+	mMemoryUsed += mUndo.back().bytes();
+
+	enforceBudget();
+}
+
+
+/**
+ * Sets the tile index of a cell, recording the change.
+ */
+void UndoJournal::index(Cell::TileLayer layer, int x, int y, int index)
+{
+	int before = mField->index(layer, x, y);
+	if (before == index)
+		return;
+
+	record(layer, x, y, before, index);
+	mField->index(layer, x, y, index);
+}
+
+
+/**
+ * Sets whether a cell is blocked, recording the change.
+ */
+void UndoJournal::blocked(int x, int y, bool blocked)
+{
+	bool before = mField->blocked(x, y);
+	if (before == blocked)
+		return;
+
+	if (mRecording)
+	{
+		Change _c = { x, y, static_cast<short>(before), static_cast<short>(blocked), CHANGE_COLLISION };
+		mStroke.changes.push_back(_c);
+		mStroke.include(x, y);
+	}
+
+	mField->blocked(x, y, blocked);
+}
+
+
+/**
+ * Links a cell to another map, recording the change.
+ */
+void UndoJournal::link(int x, int y, const std::string& destination, const Point_2d& pt)
+{
+	const std::string& beforeDestination = mField->link(x, y);
+	Point_2d beforePosition = mField->linkDestination(x, y);
+
+	if (beforeDestination == destination && beforePosition.x() == pt.x() && beforePosition.y() == pt.y())
+		return;
+
+	if (mRecording)
+	{
+		LinkChange _l;
+		_l.x = x;
+		_l.y = y;
+		_l.beforeDestination = beforeDestination;
+		_l.beforePosition = beforePosition;
+		_l.afterDestination = destination;
+		_l.afterPosition = pt;
+
+		mStroke.linkChanges.push_back(_l);
+		mStroke.include(x, y);
+	}
+
+	mField->link(x, y, destination, pt);
+}
+
+
+/**
+ * Records a tile index change that the caller has made, or is about to
+ * make, directly to the GameField. Used by tools that write through spans.
+ */
+void UndoJournal::record(Cell::TileLayer layer, int x, int y, int before, int after)
+{
+	if (!mRecording)
+		return;
+
+	Change _c = { x, y, static_cast<short>(before), static_cast<short>(after), static_cast<unsigned char>(layer) };
+	mStroke.changes.push_back(_c);
+	mStroke.include(x, y);
+}
+
+
+/**
+ * Undoes the most recent entry.
+ * 
+ * \return	True if anything was undone.
+ */
+bool UndoJournal::undo()
+{
+	TraceScope trace("UndoJournal::undo", "undo");
+
+	endStroke();
+
+	if (mUndo.empty())
+		return false;
+
+	apply(mUndo.back(), true);
+
+	mRedo.push_back(Entry());
+	std::swap(mRedo.back(), mUndo.back());
+	mUndo.pop_back();
+
+	return true;
+}
+
+
+/**
+ * Redoes the most recently undone entry.
+ * 
+ * \return	True if anything was redone.
+ */
+bool UndoJournal::redo()
+{
+	TraceScope trace("UndoJournal::redo", "undo");
+
+	endStroke();
+
+	if (mRedo.empty())
+		return false;
+
+	apply(mRedo.back(), false);
+
+	mUndo.push_back(Entry());
+	std::swap(mUndo.back(), mRedo.back());
+	mRedo.pop_back();
+
+	return true;
+}
+
+
+/**
+ * Drops all undo and redo history.
+ */
+void UndoJournal::clear()
+{
+	mUndo.clear();
+	mRedo.clear();
+	mStroke = Entry();
+	mMemoryUsed = 0;
+	mRecording = false;
+}
+
+
+/**
+ * Writes the before (undo) or after (redo) values of an entry back
+ * into the GameField. Undo walks the changes in reverse so that a cell
+ * changed several times in one stroke ends up with its original value.
+ */
+void UndoJournal::apply(const Entry& entry, bool undo)
+{
+	size_t count = entry.changes.size();
+	for (size_t n = 0; n < count; n++)
+	{
+		const Change& _c = entry.changes[undo ? count - 1 - n : n];
+		int value = undo ? _c.before : _c.after;
+
+		if (_c.layer == CHANGE_COLLISION)
+			mField->blocked(_c.x, _c.y, value != 0);
+		else
+			mField->index(static_cast<Cell::TileLayer>(_c.layer), _c.x, _c.y, value);
+	}
+
+	count = entry.linkChanges.size();
+	for (size_t n = 0; n < count; n++)
+	{
+		const LinkChange& _l = entry.linkChanges[undo ? count - 1 - n : n];
+
+		if (undo)
+			mField->link(_l.x, _l.y, _l.beforeDestination, _l.beforePosition);
+		else
+			mField->link(_l.x, _l.y, _l.afterDestination, _l.afterPosition);
+	}
+
+	mLastChangedArea = Rectangle_2d(entry.minX, entry.minY, entry.maxX - entry.minX + 1, entry.maxY - entry.minY + 1);
+}
+
+
+/**
+ * Drops redo entries and then the oldest undo entries until the journal
+ * is within budget.
+ */
+void UndoJournal::enforceBudget()
+{
+	while (mMemoryUsed > mBudget && !mRedo.empty())
+	{
+		mMemoryUsed -= mRedo.front().bytes();
+		mRedo.pop_front();
+	}
+
+	while (mMemoryUsed > mBudget && mUndo.size() > 1)
+	{
+		mMemoryUsed -= mUndo.front().bytes();
+		mUndo.pop_front();
+	}
+}
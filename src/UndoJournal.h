@@ -0,0 +1,123 @@
+#pragma once
+
+#include "NAS2D/NAS2D.h"
+
+#include "Map/GameField.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace NAS2D;
+
+/**
+ * \class UndoJournal
+ * \brief Multi-level undo/redo for edits made to a GameField.
+ * 
+ * Instead of copying the whole field before every edit, the journal records
+ * only the cells that an edit actually changed along with their old and new
+ * values. All changes made between beginStroke() and endStroke() are
+ * coalesced into a single undo entry so one mouse-down/up stroke, fill or
+ * collision edit undoes in one step.
+ * 
+ * The journal keeps its entries within a memory budget by dropping the
+ * oldest entries first.
+ */
+class UndoJournal
+{
+public:
+
+	UndoJournal();
+
+	void field(GameField* field);
+
+	void budget(size_t bytes);
+	size_t budget() const { return mBudget; }
+
+	void beginStroke();
+	void endStroke();
+	bool recording() const { return mRecording; }
+
+	void index(Cell::TileLayer layer, int x, int y, int index);
+	void blocked(int x, int y, bool blocked);
+	void link(int x, int y, const std::string& destination, const Point_2d& pt);
+
+	void record(Cell::TileLayer layer, int x, int y, int before, int after);
+
+	bool undo();
+	bool redo();
+
+	bool canUndo() const { return !mUndo.empty(); }
+	bool canRedo() const { return !mRedo.empty(); }
+
+	void clear();
+
+	size_t size() const { return mUndo.size(); }
+	size_t memoryUsed() const { return mMemoryUsed; }
+
+	const Rectangle_2d& lastChangedArea() const { return mLastChangedArea; }
+
+private:
+
+	static const unsigned char CHANGE_COLLISION = Cell::LAYER_COUNT;
+
+	/**
+	 * Before and after value of a single layer of a single cell.
+	 */
+	struct Change
+	{
+		int					x;
+		int					y;
+		short				before;
+		short				after;
+		unsigned char		layer;		/**< Cell::TileLayer or CHANGE_COLLISION. */
+	};
+
+	/**
+	 * Before and after state of a linked cell.
+	 */
+	struct LinkChange
+	{
+		int					x;
+		int					y;
+		std::string			beforeDestination;
+		Point_2d			beforePosition;
+		std::string			afterDestination;
+		Point_2d			afterPosition;
+	};
+
+	/**
+	 * Everything changed by one stroke.
+	 */
+	struct Entry
+	{
+		Entry(): minX(0), minY(0), maxX(-1), maxY(-1) {}
+
+		size_t bytes() const;
+		void include(int x, int y);
+
+		std::vector<Change>			changes;
+		std::vector<LinkChange>		linkChanges;
+
+		int							minX, minY, maxX, maxY;
+	};
+
+	typedef std::deque<Entry> EntryList;
+
+	void apply(const Entry& entry, bool undo);
+	void enforceBudget();
+
+	GameField*		mField;				/**< GameField being edited. Not owned by the journal. */
+
+	EntryList		mUndo;				/**< Undo entries, oldest first. */
+	EntryList		mRedo;				/**< Redo entries, most recently undone last. */
+
+	Entry			mStroke;			/**< Entry being recorded by the current stroke. */
+
+	Rectangle_2d	mLastChangedArea;	/**< Cell area touched by the last stroke, undo or redo. */
+
+	size_t			mBudget;			/**< Maximum number of bytes the journal may use. */
+	size_t			mMemoryUsed;		/**< Bytes used by the undo and redo entries. */
+
+	bool			mRecording;			/**< Flag indicating that a stroke is being recorded. */
+};
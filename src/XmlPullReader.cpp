@@ -0,0 +1,375 @@
+#include "XmlPullReader.h"
+
+#include <cstring>
+
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+static bool isNameChar(char c)
+{
+	return !isSpace(c) && c != '/' && c != '>' && c != '=' && c != '<';
+}
+
+
+/**
+ * Finds the first occurrence of a string within [begin, end). Returns null
+ * if it isn't there.
+ */
+const char* XmlPullReader::find(const char* begin, const char* end, const char* str)
+{
+	size_t length = std::strlen(str);
+	for (const char* _p = begin; _p + length <= end; _p++)
+	{
+		_p = static_cast<const char*>(std::memchr(_p, str[0], end - _p));
+		if (!_p || _p + length > end)
+			return nullptr;
+
+		if (std::memcmp(_p, str, length) == 0)
+			return _p;
+	}
+
+	return nullptr;
+}
+
+
+/**
+ * Compares an attribute's name to a null terminated string.
+ */
+bool XmlPullReader::Attribute::is(const char* str) const
+{
+	return std::strlen(str) == nameLength && std::memcmp(name, str, nameLength) == 0;
+}
+
+
+/**
+ * C'tor
+ * 
+ * \param	begin	First character of the XML to read.
+ * \param	end		One past the last character of the XML to read.
+ */
+XmlPullReader::XmlPullReader(const char* begin, const char* end):	mPosition(begin),
+																	mEnd(end),
+																	mName(nullptr),
+																	mNameLength(0),
+																	mAttributes(nullptr),
+																	mAttributesEnd(nullptr),
+																	mText(nullptr),
+																	mTextLength(0)
+{}
+
+
+/**
+ * Advances to the next tag or run of text.
+ */
+XmlPullReader::Token XmlPullReader::next()
+{
+	mAttributes = mAttributesEnd = nullptr;
+
+	while (mPosition < mEnd)
+	{
+		if (*mPosition != '<')
+		{
+			const char* tag = static_cast<const char*>(std::memchr(mPosition, '<', mEnd - mPosition));
+			const char* textEnd = tag ? tag : mEnd;
+
+			const char* _p = mPosition;
+			while (_p < textEnd && isSpace(*_p))
+				_p++;
+
+			mText = mPosition;
+			mTextLength = textEnd - mPosition;
+			mPosition = textEnd;
+
+			if (_p < textEnd)
+				return TOKEN_TEXT;
+
+			continue;
+		}
+
+		// Comments, CDATA, declarations and processing instructions.
+		if (mPosition + 1 < mEnd && (mPosition[1] == '!' || mPosition[1] == '?'))
+		{
+			if (mEnd - mPosition >= 4 && std::memcmp(mPosition, "<!--", 4) == 0)
+			{
+				const char* _p = find(mPosition + 4, mEnd, "-->");
+				if (!_p)
+					return TOKEN_ERROR;
+				mPosition = _p + 3;
+			}
+			else if (mEnd - mPosition >= 9 && std::memcmp(mPosition, "<![CDATA[", 9) == 0)
+			{
+				const char* _p = find(mPosition + 9, mEnd, "]]>");
+				if (!_p)
+					return TOKEN_ERROR;
+
+				mText = mPosition + 9;
+				mTextLength = _p - mText;
+				mPosition = _p + 3;
+				return TOKEN_TEXT;
+			}
+			else
+			{
+				const char* _p = static_cast<const char*>(std::memchr(mPosition, '>', mEnd - mPosition));
+				if (!_p)
+					return TOKEN_ERROR;
+				mPosition = _p + 1;
+			}
+
+			continue;
+		}
+
+		bool closing = mPosition + 1 < mEnd && mPosition[1] == '/';
+
+		const char* _p = mPosition + (closing ? 2 : 1);
+		mName = _p;
+		while (_p < mEnd && isNameChar(*_p))
+			_p++;
+		mNameLength = _p - mName;
+
+		const char* tagEnd = static_cast<const char*>(std::memchr(_p, '>', mEnd - _p));
+		if (!tagEnd || mNameLength == 0)
+			return TOKEN_ERROR;
+
+		mPosition = tagEnd + 1;
+
+		if (closing)
+			return TOKEN_END;
+
+		bool empty = tagEnd[-1] == '/';
+		mAttributes = _p;
+		mAttributesEnd = empty ? tagEnd - 1 : tagEnd;
+
+		return empty ? TOKEN_EMPTY : TOKEN_START;
+	}
+
+	return TOKEN_EOF;
+}
+
+
+/**
+ * Compares the name of the current tag to a null terminated string.
+ */
+bool XmlPullReader::isName(const char* str) const
+{
+	return std::strlen(str) == mNameLength && std::memcmp(mName, str, mNameLength) == 0;
+}
+
+
+/**
+ * Reads the next attribute of the current tag.
+ * 
+ * \return	False when there are no more attributes.
+ */
+bool XmlPullReader::nextAttribute(Attribute& attribute)
+{
+	if (!mAttributes)
+		return false;
+
+	const char* _p = mAttributes;
+	while (_p < mAttributesEnd && isSpace(*_p))
+		_p++;
+
+	attribute.name = _p;
+	while (_p < mAttributesEnd && isNameChar(*_p))
+		_p++;
+	attribute.nameLength = _p - attribute.name;
+
+	while (_p < mAttributesEnd && isSpace(*_p))
+		_p++;
+
+	if (attribute.nameLength == 0 || _p >= mAttributesEnd || *_p != '=')
+	{
+		mAttributes = nullptr;
+		return false;
+	}
+
+	_p++;
+	while (_p < mAttributesEnd && isSpace(*_p))
+		_p++;
+
+	if (_p >= mAttributesEnd || (*_p != '"' && *_p != '\''))
+	{
+		mAttributes = nullptr;
+		return false;
+	}
+
+	const char* valueEnd = static_cast<const char*>(std::memchr(_p + 1, *_p, mAttributesEnd - _p - 1));
+	if (!valueEnd)
+	{
+		mAttributes = nullptr;
+		return false;
+	}
+
+	attribute.value = _p + 1;
+	attribute.valueLength = valueEnd - attribute.value;
+
+	mAttributes = valueEnd + 1;
+	return true;
+}
+
+
+/**
+ * Converts a decimal integer the same way sscanf's %d does: leading
+ * whitespace is skipped and conversion stops at the first character
+ * that isn't a digit. Returns 0 if there are no digits.
+ */
+int XmlPullReader::toInt(const char* str, size_t length)
+{
+	size_t i = 0;
+	while (i < length && isSpace(str[i]))
+		i++;
+
+	bool negative = false;
+	if (i < length && (str[i] == '-' || str[i] == '+'))
+	{
+		negative = str[i] == '-';
+		i++;
+	}
+
+	int value = 0;
+	for (; i < length && str[i] >= '0' && str[i] <= '9'; i++)
+		value = value * 10 + (str[i] - '0');
+
+	return negative ? -value : value;
+}
+
+
+/**
+ * Gets whether a value is "true", ignoring case.
+ */
+bool XmlPullReader::isTrue(const char* str, size_t length)
+{
+	return length == 4 && (str[0] | 0x20) == 't' && (str[1] | 0x20) == 'r' && (str[2] | 0x20) == 'u' && (str[3] | 0x20) == 'e';
+}
+
+
+/**
+ * Gets the value of a hexadecimal digit or -1 if it isn't one.
+ */
+static int hexDigit(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+	return -1;
+}
+
+
+/**
+ * Appends a character to a string as UTF-8.
+ */
+static void appendUtf8(std::string& str, unsigned long c)
+{
+	if (c < 0x80)
+	{
+		str += static_cast<char>(c);
+	}
+	else if (c < 0x800)
+	{
+		str += static_cast<char>(0xc0 | (c >> 6));
+		str += static_cast<char>(0x80 | (c & 0x3f));
+	}
+	else if (c < 0x10000)
+	{
+		str += static_cast<char>(0xe0 | (c >> 12));
+		str += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+		str += static_cast<char>(0x80 | (c & 0x3f));
+	}
+	else
+	{
+		str += static_cast<char>(0xf0 | (c >> 18));
+		str += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+		str += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+		str += static_cast<char>(0x80 | (c & 0x3f));
+	}
+}
+
+
+/**
+ * Decodes the five predefined entities and character references in a value
+ * the way TinyXML does, character references becoming UTF-8. Anything that
+ * isn't a recognized entity is copied as is.
+ */
+std::string XmlPullReader::decode(const char* str, size_t length)
+{
+	static const struct { const char* entity; size_t length; char c; } ENTITIES[] =
+	{
+		{ "&amp;", 5, '&' },
+		{ "&lt;", 4, '<' },
+		{ "&gt;", 4, '>' },
+		{ "&quot;", 6, '"' },
+		{ "&apos;", 6, '\'' }
+	};
+
+	std::string decoded;
+	decoded.reserve(length);
+
+	size_t i = 0;
+	while (i < length)
+	{
+		const char* amp = static_cast<const char*>(std::memchr(str + i, '&', length - i));
+		size_t run = amp ? static_cast<size_t>(amp - str) : length;
+		decoded.append(str + i, run - i);
+		i = run;
+
+		if (i == length)
+			break;
+
+		const char* semicolon = static_cast<const char*>(std::memchr(str + i, ';', length - i));
+		size_t entityLength = semicolon ? static_cast<size_t>(semicolon - (str + i)) + 1 : 0;
+
+		bool known = false;
+		if (entityLength > 3 && str[i + 1] == '#')
+		{
+			bool hex = str[i + 2] == 'x';
+			unsigned long c = 0;
+			size_t digits = 0;
+			for (size_t j = i + (hex ? 3 : 2); j < i + entityLength - 1 && c <= 0x10ffff; j++, digits++)
+			{
+				int digit = hexDigit(str[j]);
+				if (digit < 0 || (!hex && digit > 9))
+				{
+					digits = 0;
+					break;
+				}
+
+				c = c * (hex ? 16 : 10) + digit;
+			}
+
+			if (digits > 0 && c <= 0x10ffff)
+			{
+				appendUtf8(decoded, c);
+				known = true;
+			}
+		}
+		else
+		{
+			for (size_t e = 0; e < sizeof(ENTITIES) / sizeof(ENTITIES[0]); e++)
+			{
+				if (entityLength == ENTITIES[e].length && std::memcmp(str + i, ENTITIES[e].entity, entityLength) == 0)
+				{
+					decoded += ENTITIES[e].c;
+					known = true;
+					break;
+				}
+			}
+		}
+
+		if (known)
+		{
+			i += entityLength;
+		}
+		else
+		{
+			decoded += '&';
+			i++;
+		}
+	}
+
+	return decoded;
+}
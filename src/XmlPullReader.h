@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+ * \class XmlPullReader
+ * \brief Minimal forward-only XML reader that works in place.
+ * 
+ * Walks a block of XML one tag or run of text at a time without building a
+ * document tree or copying anything. Names, attribute values and text are
+ * handed out as pointer/length pairs into the original buffer, entities are
+ * not decoded. Use decode() on values that may contain them.
+ * 
+ * Intended for sections of a file that hold far too many elements for a
+ * TiXmlDocument to be practical, e.g. the cells of a map. Comments,
+ * processing instructions and declarations are skipped.
+ */
+class XmlPullReader
+{
+public:
+
+	enum Token
+	{
+		TOKEN_START,		/**< Opening tag, <name ...>. */
+		TOKEN_EMPTY,		/**< Self closing tag, <name ... />. */
+		TOKEN_END,			/**< Closing tag, </name>. */
+		TOKEN_TEXT,			/**< Text between tags that isn't all whitespace. */
+		TOKEN_EOF,			/**< End of the buffer. */
+		TOKEN_ERROR			/**< Malformed markup. Reading stops. */
+	};
+
+	/**
+	 * Single attribute of the current tag.
+	 */
+	struct Attribute
+	{
+		const char*		name;
+		size_t			nameLength;
+		const char*		value;
+		size_t			valueLength;
+
+		bool is(const char* str) const;
+	};
+
+public:
+
+	XmlPullReader(const char* begin, const char* end);
+
+	Token next();
+
+	bool isName(const char* str) const;
+
+	const char* name() const { return mName; }
+	size_t nameLength() const { return mNameLength; }
+
+	/**
+	 * Gets the current read position within the buffer.
+	 */
+	const char* position() const { return mPosition; }
+
+	const char* text() const { return mText; }
+	size_t textLength() const { return mTextLength; }
+
+	bool nextAttribute(Attribute& attribute);
+
+	static int toInt(const char* str, size_t length);
+	static bool isTrue(const char* str, size_t length);
+	static std::string decode(const char* str, size_t length);
+
+	static const char* find(const char* begin, const char* end, const char* str);
+
+private:
+
+	const char*		mPosition;			/**< Current read position. */
+	const char*		mEnd;				/**< End of the buffer. */
+
+	const char*		mName;				/**< Name of the current tag. */
+	size_t			mNameLength;
+
+	const char*		mAttributes;		/**< Next unread attribute of the current tag. */
+	const char*		mAttributesEnd;		/**< End of the current tag's attributes. */
+
+	const char*		mText;				/**< Current run of text. */
+	size_t			mTextLength;
+};
@@ -0,0 +1,270 @@
+#include "XmlWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+
+/**
+ * C'tor
+ */
+XmlWriter::XmlWriter(std::ostream& stream):	mStream(stream),
+											mLength(0)
+{}
+
+
+/**
+ * D'tor
+ * 
+ * Hands anything still buffered to the stream. Call flush() first to find
+ * out whether that worked.
+ */
+XmlWriter::~XmlWriter()
+{
+	drain();
+}
+
+
+/**
+ * Starts a child element of the current element.
+ */
+void XmlWriter::startElement(const char* name)
+{
+	if (!mElements.empty() && mElements.back().open)
+	{
+		put(">\n", 2);
+		mElements.back().open = false;
+	}
+
+	putIndent(mElements.size());
+	put('<');
+	put(name, std::strlen(name));
+
+	Element element = { name, true, false };
+	mElements.push_back(element);
+}
+
+
+/**
+ * Ends the current element.
+ */
+void XmlWriter::endElement()
+{
+	Element element = mElements.back();
+	mElements.pop_back();
+
+	if (element.open)
+	{
+		put(" />\n", 4);
+		return;
+	}
+
+	if (!element.text)
+		putIndent(mElements.size());
+
+	put("</", 2);
+	put(element.name, std::strlen(element.name));
+	put(">\n", 2);
+}
+
+
+/**
+ * Adds an attribute to the element that was just started.
+ */
+void XmlWriter::attribute(const char* name, const std::string& value)
+{
+	putAttribute(name, value.data(), value.size());
+}
+
+
+void XmlWriter::attribute(const char* name, const char* value)
+{
+	putAttribute(name, value, std::strlen(value));
+}
+
+
+void XmlWriter::attribute(const char* name, int value)
+{
+	put(' ');
+	putEncoded(name, std::strlen(name));
+	put("=\"", 2);
+	putInt(value);
+	put('"');
+}
+
+
+/**
+ * Adds text to the element that was just started. Can be called again to
+ * write long text in pieces. The element can't have any other children.
+ */
+void XmlWriter::text(const std::string& text)
+{
+	Element& element = mElements.back();
+
+	if (!element.text)
+	{
+		put('>');
+		element.open = false;
+		element.text = true;
+	}
+
+	putEncoded(text.data(), text.size());
+}
+
+
+/**
+ * Hands everything buffered to the stream and flushes it.
+ * 
+ * \return	False if writing to the stream failed at any point.
+ */
+bool XmlWriter::flush()
+{
+	drain();
+	mStream.flush();
+
+	return !mStream.fail();
+}
+
+
+void XmlWriter::put(const char* str, size_t length)
+{
+	while (length > 0)
+	{
+		if (mLength == BUFFER_SIZE)
+			drain();
+
+		size_t count = std::min(length, BUFFER_SIZE - mLength);
+		std::memcpy(mBuffer + mLength, str, count);
+
+		mLength += count;
+		str += count;
+		length -= count;
+	}
+}
+
+
+/**
+ * Writes a string escaping it exactly like TiXmlBase::EncodeString() does,
+ * including passing character references of the form "&#x...;" through.
+ */
+void XmlWriter::putEncoded(const char* str, size_t length)
+{
+	size_t i = 0;
+	while (i < length)
+	{
+		unsigned char c = static_cast<unsigned char>(str[i]);
+
+		if (c == '&' && i + 2 < length && str[i + 1] == '#' && str[i + 2] == 'x')
+		{
+			while (i + 1 < length)
+			{
+				put(str[i]);
+				++i;
+				if (str[i] == ';')
+					break;
+			}
+		}
+		else if (c == '&')	{ put("&amp;", 5); ++i; }
+		else if (c == '<')	{ put("&lt;", 4); ++i; }
+		else if (c == '>')	{ put("&gt;", 4); ++i; }
+		else if (c == '"')	{ put("&quot;", 6); ++i; }
+		else if (c == '\'')	{ put("&apos;", 6); ++i; }
+		else if (c < 32)
+		{
+			char buffer[8];
+			int count = std::snprintf(buffer, sizeof(buffer), "&#x%02X;", static_cast<unsigned int>(c));
+			put(buffer, static_cast<size_t>(count));
+			++i;
+		}
+		else
+		{
+			// Copy the whole run of characters that don't need escaping at once.
+			size_t run = i + 1;
+			while (run < length)
+			{
+				unsigned char _c = static_cast<unsigned char>(str[run]);
+				if (_c < 32 || _c == '&' || _c == '<' || _c == '>' || _c == '"' || _c == '\'')
+					break;
+				++run;
+			}
+
+			put(str + i, run - i);
+			i = run;
+		}
+	}
+}
+
+
+/**
+ * Formats an integer in decimal, same as "%d", into the INT_LENGTH
+ * characters before END.
+ * 
+ * \return	First character of the formatted integer.
+ */
+char* XmlWriter::formatInt(int value, char* end)
+{
+	char* _p = end;
+
+	// Work with the magnitude as unsigned so INT_MIN doesn't overflow.
+	unsigned int magnitude = value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+
+	do
+	{
+		*--_p = static_cast<char>('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude != 0);
+
+	if (value < 0)
+		*--_p = '-';
+
+	return _p;
+}
+
+
+/**
+ * Writes an integer in decimal, same as "%d".
+ */
+void XmlWriter::putInt(int value)
+{
+	char buffer[INT_LENGTH];
+	char* _p = formatInt(value, buffer + sizeof(buffer));
+
+	put(_p, static_cast<size_t>(buffer + sizeof(buffer) - _p));
+}
+
+
+/**
+ * Writes an attribute. Like TinyXML the value is quoted with single quotes
+ * if it contains a double quote, even though it's escaped either way.
+ */
+void XmlWriter::putAttribute(const char* name, const char* value, size_t length)
+{
+	char quote = std::memchr(value, '"', length) ? '\'' : '"';
+
+	put(' ');
+	putEncoded(name, std::strlen(name));
+	put('=');
+	put(quote);
+	putEncoded(value, length);
+	put(quote);
+}
+
+
+void XmlWriter::putIndent(size_t depth)
+{
+	for (size_t i = 0; i < depth; i++)
+		put("    ", 4);
+}
+
+
+/**
+ * Hands the buffer to the stream.
+ */
+void XmlWriter::drain()
+{
+	if (mLength == 0)
+		return;
+
+	mStream.write(mBuffer, mLength);
+	mLength = 0;
+}
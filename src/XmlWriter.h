@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * \class XmlWriter
+ * \brief Minimal forward-only XML writer that streams to an output stream.
+ * 
+ * Formats elements, attributes and text straight into a small fixed buffer
+ * that's handed to the stream whenever it fills up, nothing is built up in
+ * memory. Output is byte for byte what TiXmlPrinter produces for the same
+ * document with its default settings: four space indents, one element per
+ * line, elements without children closed with " />" and elements whose only
+ * child is text kept on one line. Names and values are escaped the same way
+ * TinyXML escapes them.
+ * 
+ * \note	Element names aren't copied and have to outlive the element,
+ *			string literals are expected.
+ */
+class XmlWriter
+{
+public:
+
+	explicit XmlWriter(std::ostream& stream);
+	~XmlWriter();
+
+	void startElement(const char* name);
+	void endElement();
+
+	void attribute(const char* name, const std::string& value);
+	void attribute(const char* name, const char* value);
+	void attribute(const char* name, int value);
+
+	void text(const std::string& text);
+
+	bool flush();
+
+	static char* formatInt(int value, char* end);
+
+	static const size_t INT_LENGTH = 12;		/**< Most characters formatInt() writes. */
+
+private:
+
+	XmlWriter(const XmlWriter&);				// Explicitly disallowed
+	XmlWriter& operator=(const XmlWriter&);		// Explicitly disallowed
+
+	/**
+	 * Element that's been started but not ended.
+	 */
+	struct Element
+	{
+		const char*		name;
+		bool			open;		/**< Start tag is still waiting for its closing '>'. */
+		bool			text;		/**< Only child is text, the end tag goes on the same line. */
+	};
+
+	void put(char c) { if (mLength == BUFFER_SIZE) drain(); mBuffer[mLength++] = c; }
+	void put(const char* str, size_t length);
+	void putEncoded(const char* str, size_t length);
+	void putInt(int value);
+	void putAttribute(const char* name, const char* value, size_t length);
+	void putIndent(size_t depth);
+
+	void drain();
+
+	static const size_t BUFFER_SIZE = 16384;
+
+	std::ostream&			mStream;				/**< Stream the output goes to. */
+	std::vector<Element>	mElements;				/**< Elements that have been started, innermost last. */
+
+	char					mBuffer[BUFFER_SIZE];	/**< Output not yet handed to mStream. */
+	size_t					mLength;				/**< Number of characters in mBuffer. */
+};
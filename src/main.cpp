@@ -4,6 +4,7 @@
 #include "StartState.h"
 
 #include "Defaults.h"
+#include "TraceRecorder.h"
 
 
 #ifdef WINDOWS
@@ -21,11 +22,16 @@ int main(int argc, char *argv[])
 	freopen_s(&stream, "log_editor.txt", "w", stdout);
 	#endif
 
+	TraceRecorder::nameThread("Main");
+
 	try
 	{
 		Game game("Landlord", argv[0], "editor.xml");
 		game.mount("editor.zip");
 		game.go(new StartState());
+
+		// Cached tileset textures have to go while there's still a renderer.
+		Tileset::clearCache();
 	}
 	catch(Exception e)
 	{